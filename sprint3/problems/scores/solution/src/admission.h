@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace admission {
+
+// Ограничения нагрузки. Нулевое значение снимает ограничение
+struct Limits {
+    // Запросы API, ожидающие или выполняющиеся в strand-е API
+    std::size_t max_api_queue_depth = 0;
+    // Время ожидания запроса API в очереди strand-а, после которого запрос отклоняется
+    std::chrono::milliseconds max_api_queue_age{0};
+    // Одновременно обрабатываемые запросы статических файлов
+    std::size_t max_static_requests = 0;
+    // Значение заголовка Retry-After отклонённых запросов
+    std::chrono::seconds retry_after{1};
+};
+
+class Budget;
+
+// Место в бюджете, освобождается при разрушении. Билет продлевает жизнь бюджета:
+// он может пережить владельца бюджета, например, в ответе, который ещё отправляется при остановке сервера
+class Ticket {
+public:
+    Ticket() = default;
+
+    Ticket(Ticket&& other) noexcept
+        : budget_(std::move(other.budget_)) {
+    }
+
+    Ticket& operator=(Ticket&& other) noexcept {
+        if (this != &other) {
+            Release();
+            budget_ = std::move(other.budget_);
+        }
+        return *this;
+    }
+
+    ~Ticket() {
+        Release();
+    }
+
+    explicit operator bool() const noexcept {
+        return budget_ != nullptr;
+    }
+
+    inline void Release() noexcept;
+
+private:
+    friend class Budget;
+
+    explicit Ticket(std::shared_ptr<Budget> budget) noexcept
+        : budget_(std::move(budget)) {
+    }
+
+    std::shared_ptr<Budget> budget_;
+};
+
+// Счётчик занятых мест с ограничением. Места занимаются и освобождаются без блокировок из любых потоков.
+// Бюджет должен принадлежать std::shared_ptr, чтобы выданные билеты могли его удерживать
+class Budget : public std::enable_shared_from_this<Budget> {
+public:
+    // limit == 0 - без ограничения
+    explicit Budget(std::size_t limit) noexcept
+        : limit_(limit) {
+    }
+
+    Budget(const Budget&) = delete;
+    Budget& operator=(const Budget&) = delete;
+
+    // Пустой Ticket, если все места заняты. Отказ учитывается в счётчике отклонённых
+    Ticket TryAcquire() {
+        const auto in_use = in_use_.fetch_add(1, std::memory_order_relaxed);
+        if (limit_ != 0 && in_use >= limit_) {
+            in_use_.fetch_sub(1, std::memory_order_relaxed);
+            CountRejected();
+            return Ticket{};
+        }
+        return Ticket{shared_from_this()};
+    }
+
+    // Учитывает отказ, принятый вне бюджета (например, по времени ожидания)
+    void CountRejected() noexcept {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::size_t GetInUse() const noexcept {
+        return in_use_.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t GetRejectedCount() const noexcept {
+        return rejected_.load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class Ticket;
+
+    void Release() noexcept {
+        in_use_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    const std::size_t limit_;
+    std::atomic<std::size_t> in_use_{0};
+    std::atomic<std::uint64_t> rejected_{0};
+};
+
+inline void Ticket::Release() noexcept {
+    if (budget_) {
+        std::exchange(budget_, nullptr)->Release();
+    }
+}
+
+}  // namespace admission
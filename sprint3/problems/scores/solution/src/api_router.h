@@ -0,0 +1,127 @@
+#pragma once
+
+#include <boost/beast/http/verb.hpp>
+#include <boost/url/decode_view.hpp>
+#include <boost/url/pct_string_view.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+namespace http_handler {
+
+// Бит метода в маске разрешённых методов маршрута
+constexpr std::uint64_t MethodBit(boost::beast::http::verb verb) noexcept {
+    return std::uint64_t{1} << static_cast<unsigned>(verb);
+}
+
+/*
+ * Декодированный путь запроса и строка его параметров.
+ * Путь хранится во внутреннем буфере, поэтому его можно копировать без выделения памяти.
+ * Путь длиннее MAX_SIZE или с некорректным %-кодированием считается недействительным.
+ * Строка параметров не декодируется и ссылается на target запроса, поэтому действительна, пока жив запрос
+ */
+class DecodedPath {
+public:
+    static constexpr std::size_t MAX_SIZE = 256;
+
+    explicit DecodedPath(std::string_view target) noexcept {
+        const auto query_pos = target.find('?');
+        if (query_pos != std::string_view::npos) {
+            query_ = target.substr(query_pos + 1);
+        }
+        auto encoded = boost::urls::make_pct_string_view(target.substr(0, query_pos));
+        if (!encoded || encoded->decoded_size() > MAX_SIZE) {
+            return;
+        }
+        boost::urls::decode_view decoded(*encoded);
+        size_ = static_cast<std::size_t>(std::copy(decoded.begin(), decoded.end(), data_.begin()) - data_.begin());
+        valid_ = true;
+    }
+
+    bool IsValid() const noexcept {
+        return valid_;
+    }
+
+    std::string_view View() const noexcept {
+        return {data_.data(), size_};
+    }
+
+    // Строка параметров без '?' (пустая, если параметров нет)
+    std::string_view Query() const noexcept {
+        return query_;
+    }
+
+private:
+    std::array<char, MAX_SIZE> data_{};
+    std::size_t size_ = 0;
+    std::string_view query_;
+    bool valid_ = false;
+};
+
+/*
+ * Таблица маршрутов, построенная на этапе компиляции.
+ * Route - структура с полями path (путь или, если has_param, префикс пути перед параметром) и has_param.
+ * Пути без параметров ищутся в хеш-таблице с открытой адресацией, маршруты с параметром -
+ * по префиксу (параметр - непустой остаток пути)
+ */
+template <typename Route, std::size_t RouteCount>
+class Router {
+public:
+    constexpr explicit Router(const std::array<Route, RouteCount>& routes)
+        : routes_(routes) {
+        slots_.fill(EMPTY_SLOT);
+        for (std::size_t i = 0; i < RouteCount; ++i) {
+            if (routes_[i].has_param) {
+                continue;
+            }
+            auto slot = Hash(routes_[i].path) % TABLE_SIZE;
+            while (slots_[slot] != EMPTY_SLOT) {
+                slot = (slot + 1) % TABLE_SIZE;
+            }
+            slots_[slot] = static_cast<std::uint8_t>(i);
+        }
+    }
+
+    constexpr const Route* Match(std::string_view path) const noexcept {
+        for (auto slot = Hash(path) % TABLE_SIZE; slots_[slot] != EMPTY_SLOT; slot = (slot + 1) % TABLE_SIZE) {
+            const Route& route = routes_[slots_[slot]];
+            if (route.path == path) {
+                return &route;
+            }
+        }
+        for (const Route& route : routes_) {
+            if (route.has_param && path.size() > route.path.size() && path.starts_with(route.path)) {
+                return &route;
+            }
+        }
+        return nullptr;
+    }
+
+    // Параметр маршрута, найденного для path
+    static constexpr std::string_view GetParam(const Route& route, std::string_view path) noexcept {
+        return route.has_param ? path.substr(route.path.size()) : std::string_view{};
+    }
+
+private:
+    static_assert(RouteCount < 0xFF);
+
+    static constexpr std::size_t TABLE_SIZE = std::bit_ceil(RouteCount * 2);
+    static constexpr std::uint8_t EMPTY_SLOT = 0xFF;
+
+    // FNV-1a
+    static constexpr std::uint64_t Hash(std::string_view str) noexcept {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (char c : str) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::array<Route, RouteCount> routes_;
+    std::array<std::uint8_t, TABLE_SIZE> slots_{};
+};
+
+}  // namespace http_handler
@@ -1,28 +1,50 @@
 #include "application.h"
 
+#include <cassert>
+#include <iomanip>
+#include <sstream>
+
 namespace game_scenarios {
 
-json::value Application::GetMapsShortInfo() const noexcept {
-    return json_parser::MapsToShortJson(game_.GetMaps());
+const SerializedJson& Application::GetMapsShortInfo() const noexcept {
+    return maps_short_info_;
 }
 
-json::value Application::GetMapInfo(const std::string& map_id) const {
-    auto map = game_.FindMap(model::Map::Id{map_id});
-    if (!map) {
+const SerializedJson& Application::GetMapInfo(std::string_view map_id) const {
+    auto map_info = map_id_to_info_.find(map_id);
+    if (map_info == map_id_to_info_.end()) {
         throw AppErrorException("Map not found"s, AppErrorException::Category::InvalidMapId);
     }
-    return json_parser::MapToJson(map, extra_data_);
+    return map_info->second;
 }
 
-json::value Application::GetPlayers(const Players::Token& player_token) {
-    auto player = players_.FindByToken(player_token);
-    if (!player) {
-        throw AppErrorException("No player with token"s, AppErrorException::Category::NoPlayerWithToken);
+void Application::SerializeMaps() {
+    maps_short_info_ = MakeSerializedJson(json_parser::MapsToShortJson(game_.GetMaps()));
+    for (const auto& map : game_.GetMaps()) {
+        map_id_to_info_.emplace(*map.GetId(), MakeSerializedJson(json_parser::MapToJson(&map, extra_data_)));
     }
+}
+
+SerializedJson Application::MakeSerializedJson(const json::value& value) {
+    auto body = std::make_shared<const std::string>(json::serialize(value));
+
+    // ETag - 64-битный хеш FNV-1a тела ответа, одинаковый между перезапусками сервера
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : *body) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    std::ostringstream etag;
+    etag << '"' << std::hex << std::setw(16) << std::setfill('0') << hash << '"';
+
+    return SerializedJson{std::move(body), etag.str()};
+}
+
+json::value Application::GetPlayers(const Players::Token& player_token) const {
+    auto session_snapshot = GetSessionSnapshot(player_token);
     
     json::object players_by_id;
-    for (const auto& dog : player->GetSession()->GetDogs()) {
-        players_by_id[std::to_string(dog->GetId())] = json::object{{"name"sv, dog->GetName()}};
+    for (const auto& player_state : session_snapshot->players) {
+        players_by_id[std::to_string(player_state.id)] = json::object{{"name"sv, player_state.name}};
     }
     return players_by_id;
 }
@@ -37,58 +59,114 @@ json::value Application::JoinGame(const std::string& user_name, const std::strin
         throw AppErrorException("Map not found"s, AppErrorException::Category::InvalidMapId);
     }
     
-    auto game_session = game_.FindSession(map);
-    if (!game_session) {
-        game_session = game_.CreateSession(map);
-    }
+    auto game_session = game_.GetSessionToJoin(map);
     auto dog = game_session->CreateDog(user_name, randomize_spawn_points_);
     auto player_info = players_.Add(dog, game_session);
 
     return json::object{
-        {"authToken"sv, player_info.token}, 
+        {"authToken"sv, player_info.token.ToString()}, 
         {"playerId"sv, player_info.player->GetId()
     }};
 }
 
-json::value Application::GetGameState(const Players::Token& player_token) {
-    auto player = players_.FindByToken(player_token);
-    if (!player) {
-        throw AppErrorException("No player with token"s, AppErrorException::Category::NoPlayerWithToken);
+std::shared_ptr<const std::string> Application::GetSerializedGameState(const Players::Token& player_token) const {
+    return GetSessionSnapshot(player_token)->GetSerialized([](const SessionSnapshot& session_snapshot) {
+        return json::serialize(GameStateToJson(session_snapshot));
+    });
+}
+
+json::value Application::GetGameStateChanges(const Players::Token& player_token, std::uint64_t since_tick) const {
+    auto session_snapshot = GetSessionSnapshot(player_token);
+
+    // Тик слишком старый (или из будущего): отдаём полное состояние
+    if (!session_snapshot->HasChangesSince(since_tick)) {
+        auto game_state = GameStateToJson(*session_snapshot).as_object();
+        game_state["tick"sv] = session_snapshot->tick;
+        game_state["full"sv] = true;
+        return game_state;
     }
-    
+
+    // Объединяем изменения тиков после since_tick
+    const auto [changed_players, added_lost_objects, removed_lost_objects] = session_snapshot->MergeChangesSince(since_tick);
+
     json::object players_by_id;
-    for (const auto& dog : player->GetSession()->GetDogs()) {
-        const auto bag_items = dog->GetBagItems();
-        json::array bag_items_json;
-        bag_items_json.reserve(bag_items.size());
-        for (const auto& item : bag_items) {
-            bag_items_json.emplace_back(json::object{
-                {"id"sv, item.id},
-                {"type"sv, item.type}
-            });
+    for (size_t i = 0; i < changed_players.size(); ++i) {
+        if (changed_players[i]) {
+            const auto& player_state = session_snapshot->players[i];
+            players_by_id[std::to_string(player_state.id)] = PlayerStateToJson(player_state);
         }
-        players_by_id[std::to_string(dog->GetId())] = json::object{
-            {"pos"sv, json::array{dog->GetPosition().x, dog->GetPosition().y}},
-            {"speed"sv, json::array{dog->GetSpeed().x, dog->GetSpeed().y}},
-            {"dir"sv, DirectionToString(dog->GetDirection())},
-            {"bag"sv, bag_items_json},
-            {"score"sv, player->GetScore()}
-        };
     }
 
-    auto lost_objects = player->GetSession()->GetLostObjects();
     json::object lost_objects_by_id;
-    for (size_t i = 0; i < lost_objects.size(); ++i) {
-        lost_objects_by_id[std::to_string(i)] = json::object{
-            {"type"sv, lost_objects.at(i).type},
-            {"pos"sv, json::array{lost_objects.at(i).position.x, lost_objects.at(i).position.y}}
-        };
+    if (!added_lost_objects.empty()) {
+        for (const auto& lost_object : session_snapshot->lost_objects) {
+            if (added_lost_objects.count(lost_object.id)) {
+                lost_objects_by_id[std::to_string(lost_object.id)] = LostObjectToJson(lost_object);
+            }
+        }
+    }
+
+    json::array removed_lost_objects_json;
+    removed_lost_objects_json.reserve(removed_lost_objects.size());
+    for (auto lost_object_id : removed_lost_objects) {
+        removed_lost_objects_json.emplace_back(lost_object_id);
+    }
+
+    return json::object{{"tick"sv, session_snapshot->tick},
+                        {"full"sv, false},
+                        {"players"sv, players_by_id},
+                        {"lostObjects"sv, lost_objects_by_id},
+                        {"removedLostObjects"sv, removed_lost_objects_json}};
+}
+
+json::value Application::GameStateToJson(const SessionSnapshot& session_snapshot) {
+    json::object players_by_id;
+    for (const auto& player_state : session_snapshot.players) {
+        players_by_id[std::to_string(player_state.id)] = PlayerStateToJson(player_state);
+    }
+
+    json::object lost_objects_by_id;
+    for (const auto& lost_object : session_snapshot.lost_objects) {
+        lost_objects_by_id[std::to_string(lost_object.id)] = LostObjectToJson(lost_object);
     }
 
     return json::object{{"players"sv, players_by_id},
                         {"lostObjects"sv, lost_objects_by_id}};
 }
 
+json::value Application::PlayerStateToJson(const SessionSnapshot::PlayerState& player_state) {
+    json::array bag_items_json;
+    bag_items_json.reserve(player_state.bag.size());
+    for (const auto& item : player_state.bag) {
+        bag_items_json.emplace_back(json::object{
+            {"id"sv, item.id},
+            {"type"sv, item.type}
+        });
+    }
+    return json::object{
+        {"pos"sv, json::array{player_state.position.x, player_state.position.y}},
+        {"speed"sv, json::array{player_state.speed.x, player_state.speed.y}},
+        {"dir"sv, DirectionToString(player_state.direction)},
+        {"bag"sv, bag_items_json},
+        {"score"sv, player_state.score}
+    };
+}
+
+json::value Application::LostObjectToJson(const GameSession::LostObject& lost_object) {
+    return json::object{
+        {"type"sv, lost_object.type},
+        {"pos"sv, json::array{lost_object.position.x, lost_object.position.y}}
+    };
+}
+
+std::shared_ptr<const SessionSnapshot> Application::GetSessionSnapshot(const Players::Token& player_token) const {
+    auto player = players_.FindByToken(player_token);
+    if (!player) {
+        throw AppErrorException("No player with token"s, AppErrorException::Category::NoPlayerWithToken);
+    }
+    return player->GetSessionSnapshot();
+}
+
 void Application::ActionPlayer(const Players::Token& player_token, const std::string& direction_str) {
     std::optional<Direction> direction;
     if (!direction_str.empty()) {
@@ -115,112 +193,198 @@ bool Application::GetAutoTick() const noexcept {
     return auto_tick_enabled_;
 }
 
+const tick_profiler::TickProfiler& Application::GetTickProfiler() const noexcept {
+    return tick_profiler_;
+}
+
 void Application::Tick(std::chrono::milliseconds delta) {
     if (delta < 0ms) {
         throw AppErrorException("Whrong time"s, AppErrorException::Category::InvalidTime);
     }
 
-    // Получаем игроков
-    const auto& players = players_.GetPlayers();
+    auto profile = tick_profiler_.BeginTick();
+    auto* tick_phases = profile ? &profile->phases : nullptr;
+    // Длительности этапов сессии sessions[i] (nullptr - без профилирования)
+    auto session_phases = [&profile](size_t i) {
+        return profile ? &profile->sessions[i].phases : nullptr;
+    };
+
+    std::vector<GameSession*> sessions;
+    {
+        tick_profiler::ScopedTimer timer(tick_phases, tick_profiler::Phase::GroupSessions);
+        sessions.reserve(players_.GetSessions().size());
+        for (const auto& [session, session_players] : players_.GetSessions()) {
+            sessions.push_back(session);
+        }
+        if (profile) {
+            profile->sessions.resize(sessions.size());
+            for (size_t i = 0; i < sessions.size(); ++i) {
+                const auto& map_id = sessions[i]->GetMap()->GetId();
+                const auto& map_sessions = game_.GetMapSessions(map_id);
+                profile->sessions[i].map_id = *map_id;
+                profile->sessions[i].session_index = static_cast<size_t>(
+                    std::find(map_sessions.begin(), map_sessions.end(), sessions[i]) - map_sessions.begin());
+            }
+        }
+    }
+
+    // Обрабатываем сессии: они не разделяют изменяемых данных, поэтому могут обрабатываться параллельно
+    ForEachSession(sessions, [this, &sessions, &session_phases, delta](size_t i) {
+        TickSession(sessions[i], players_.GetSessionPlayers(sessions[i]), delta, session_phases(i));
+    });
     
-    // Формируем игроков по сессиям
-    std::unordered_map<GameSession*, std::vector<Player*>> session_players;
-    for (const auto& player : players) {
-        session_players[player->GetSession()].emplace_back(player.get());
+    // Генерируем новый лут (генератор лута общий для всех карт, поэтому последовательно)
+    {
+        tick_profiler::ScopedTimer timer(tick_phases, tick_profiler::Phase::GenerateLoot);
+        GenerateMapsLostObjects(delta);
+    }
+
+    // Завершаем тик сессий и публикуем снимки их состояния для чтения из других потоков
+    ForEachSession(sessions, [this, &sessions, &session_phases](size_t i) {
+        tick_profiler::ScopedTimer timer(session_phases(i), tick_profiler::Phase::PublishSnapshot);
+        sessions[i]->FinishTick();
+        players_.PublishSessionSnapshot(sessions[i]);
+    });
+
+    tick_profiler_.EndTick(std::move(profile));
+}
+
+void Application::ForEachSession(const std::vector<GameSession*>& sessions, const std::function<void(size_t)>& action) {
+    if (!tick_pool_ || sessions.size() < 2) {
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            action(i);
+        }
+        return;
+    }
+
+    // Сессии разбирают рабочие потоки пула и текущий поток
+    std::atomic<size_t> next_session{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto run_sessions = [&]() noexcept {
+        for (size_t i = next_session++; i < sessions.size(); i = next_session++) {
+            try {
+                action(i);
+            } catch (...) {
+                std::lock_guard lock{error_mutex};
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    const size_t worker_count = std::min<size_t>(tick_threads_ - 1, sessions.size() - 1);
+    std::latch workers_done(static_cast<std::ptrdiff_t>(worker_count));
+    for (size_t i = 0; i < worker_count; ++i) {
+        net::post(*tick_pool_, [&] {
+            run_sessions();
+            workers_done.count_down();
+        });
     }
+    run_sessions();
+    workers_done.wait();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void Application::TickSession(GameSession* session, const std::vector<Player*>& players, std::chrono::milliseconds delta,
+                              tick_profiler::PhaseTimes* phases) {
+    using tick_profiler::Phase;
+    using tick_profiler::ScopedTimer;
 
     // Доп. данные об игроках для формирования событий в игре
     static const double player_width = 0.6;
     static const double item_width = 0.0;
     static const double base_width = 0.5;
 
-    // Идем по сессиям
-    for (const auto& [session, players] : session_players) {
-        size_t office_count = session->GetMap()->GetOffices().size();
-        
-        // Формируем информацию о базах и информацию о луте
-        std::vector<collision_detector::Item> items;
-        items.reserve(office_count + session->GetLostObjects().size());
-        for (const auto& office : session->GetMap()->GetOffices()) {
-            items.emplace_back(collision_detector::Item{{static_cast<double>(office.GetPosition().x), 
-                                                            static_cast<double>(office.GetPosition().y)}, 
-                                                            base_width});
-        }
-        auto lost_objects = session->GetLostObjects();
-        for (const auto& lost_object : lost_objects) {
-            items.emplace_back(collision_detector::Item{{lost_object.position.x, lost_object.position.y}, 
-                                                            item_width});
-        }
-
-        // Формируем информацию об игроках
-        std::vector<collision_detector::Gatherer> gatherers;
-        gatherers.reserve(players.size());
-        for (auto player : players) {
-            auto player_next_state = players_.CalcPlayerNextState(player, delta);
-            gatherers.emplace_back(collision_detector::Gatherer{{player->GetPosition().x, player->GetPosition().y},
-                                                                {player_next_state.position.x, player_next_state.position.y},
-                                                                player_width});
-        }
+    size_t office_count = session->GetMap()->GetOffices().size();
+    const auto& lost_objects = session->GetLostObjects();
+    
+    // Формируем информацию о базах и информацию о луте
+    std::optional<ScopedTimer> timer{std::in_place, phases, Phase::BuildItems};
+    const size_t item_count = office_count + lost_objects.size();
+    std::vector<double> item_xs, item_ys, item_widths;
+    item_xs.reserve(item_count);
+    item_ys.reserve(item_count);
+    item_widths.reserve(item_count);
+    for (const auto& office : session->GetMap()->GetOffices()) {
+        item_xs.emplace_back(static_cast<double>(office.GetPosition().x));
+        item_ys.emplace_back(static_cast<double>(office.GetPosition().y));
+        item_widths.emplace_back(base_width);
+    }
+    for (const auto& lost_object : lost_objects) {
+        item_xs.emplace_back(lost_object.position.x);
+        item_ys.emplace_back(lost_object.position.y);
+        item_widths.emplace_back(item_width);
+    }
 
-        // Получаем события
-        auto events = collision_detector::FindGatherEvents(collision_detector::Provider(gatherers, items));
+    // Перемещаем собак и запоминаем их пути для поиска событий.
+    // Игроки сессии добавляются вместе с собаками, поэтому собиратель (слот собаки) совпадает с индексом игрока
+    timer.emplace(phases, Phase::ComputeNextStates);
+    const size_t dog_count = session->GetDogCount();
+    assert(players.size() == dog_count);
+    const auto paths = session->MoveDogs(std::chrono::duration<DimensionD>(delta).count());
+    const std::vector<double> player_widths(dog_count, player_width);
 
-        // Определяем информацию о луте на карте (для определения очков)
-        auto map_loot_types = extra_data_.map_id_to_loot_types.at(*session->GetMap()->GetId());
+    // Получаем события
+    timer.emplace(phases, Phase::FindEvents);
+    auto events = collision_detector::FindGatherEvents(
+        collision_detector::ItemSpans{item_xs, item_ys, item_widths},
+        collision_detector::GathererSpans{paths.start_xs, paths.start_ys, paths.end_xs, paths.end_ys, player_widths});
 
-        // Разбираем события получения предметов/посещения базы
-        std::unordered_set<size_t> lost_objects_taken;
-        for (const auto& event : events) {
-            auto player = players.at(event.gatherer_id);
+    // Определяем информацию о луте на карте (для определения очков)
+    timer.emplace(phases, Phase::ApplyEvents);
+    auto map_loot_types = extra_data_.map_id_to_loot_types.at(*session->GetMap()->GetId());
 
-            // Определяем: предмет или база получены
-            bool is_office_event{event.item_id < office_count};
-            if (is_office_event) {
-                // Подсчитываем очки за лут
-                for (const auto& item : player->GetBagItems()) {
-                    player->AddScore(map_loot_types.at(item.type).as_object().at("value"sv).as_int64());
-                }
+    // Разбираем события получения предметов/посещения базы
+    std::unordered_set<GameSession::LostObject::Id> lost_objects_taken;
+    for (const auto& event : events) {
+        auto player = players.at(event.gatherer_id);
 
-                // Очищаем сумку
-                player->ClearBag();
-                continue;
+        // Определяем: предмет или база получены
+        bool is_office_event{event.item_id < office_count};
+        if (is_office_event) {
+            // Подсчитываем очки за лут
+            for (const auto& item : player->GetBagItems()) {
+                player->AddScore(map_loot_types.at(item.type).as_object().at("value"sv).as_int64());
             }
 
-            size_t lost_object_index = event.item_id - office_count;
+            // Очищаем сумку
+            player->ClearBag();
+            continue;
+        }
 
-            // Если по предмету уже прошлись: пропускаем событие
-            if (lost_objects_taken.count(lost_object_index)) {
-                continue;
-            }
+        const auto& lost_object = lost_objects.at(event.item_id - office_count);
 
-            // Если предмет смогли упаковать в рюкзак
-            if (player->AddItemInBag(lost_object_index, lost_objects.at(lost_object_index).type)) {
-                lost_objects_taken.insert(lost_object_index);
-            }
+        // Если по предмету уже прошлись: пропускаем событие
+        if (lost_objects_taken.count(lost_object.id)) {
+            continue;
         }
 
-        // Удаляем полученные игроками предметы из списка потерянных
-        for (size_t lost_object_index : lost_objects_taken) {
-            session->RemoveLostObject(lost_object_index);
+        // Если предмет смогли упаковать в рюкзак
+        if (player->AddItemInBag(lost_object.id, lost_object.type)) {
+            lost_objects_taken.insert(lost_object.id);
         }
     }
-    
-    // Генерируем новый лут
-    GenerateMapsLostObjects(delta);
+
+    // Удаляем полученные игроками предметы из списка потерянных
+    for (auto lost_object_id : lost_objects_taken) {
+        session->RemoveLostObject(lost_object_id);
+    }
 }
 
 void Application::GenerateMapsLostObjects(std::chrono::milliseconds delta) {
     for (const auto& map : game_.GetMaps()) {
-        auto session = game_.FindSession(&map);
-        if (!session) {
-            continue;
+        for (auto session : game_.GetMapSessions(map.GetId())) {
+            unsigned new_lost_object_count = loot_generator_.Generate(delta, 
+                                                                        session->GetLostObjects().size(),
+                                                                        session->GetDogCount());
+            session->GenerateLostObjects(new_lost_object_count, 
+                                            extra_data_.map_id_to_loot_types.at(*(map.GetId())).size());
         }
-
-        unsigned new_lost_object_count = loot_generator_.Generate(delta, 
-                                                                    session->GetLostObjects().size(),
-                                                                    session->GetDogs().size());
-        session->GenerateLostObjects(new_lost_object_count, 
-                                        extra_data_.map_id_to_loot_types.at(*(map.GetId())).size());
     }
 }
 
@@ -5,16 +5,31 @@
 #include "loot_generator.h"
 #include "model.h"
 #include "players.h"
+#include "tick_profiler.h"
 
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <boost/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace game_scenarios {
 using namespace model;
 using namespace players;
 
 namespace json = boost::json;
+namespace net = boost::asio;
 using namespace std::literals;
  
 class AppErrorException : public std::invalid_argument { 
@@ -58,32 +73,69 @@ struct LootInfo {
     std::unordered_map<std::string, std::unordered_map<size_t, size_t>> map_to_loot_type_score;
 };
 
+// Неизменяемый сериализованный JSON со строгим ETag
+struct SerializedJson {
+    std::shared_ptr<const std::string> body;
+    std::string etag;
+};
+
 class Application {
 public:
-    Application(Game&& game, ExtraData&& extra_data, bool randomize_spawn_points = false, bool auto_tick_enabled = false) 
+    // tick_threads - количество потоков, на которых обрабатываются игровые сессии во время тика
+    // tick_profile_depth - количество последних тиков, профили которых сохраняются (0 - без профилирования)
+    Application(Game&& game, ExtraData&& extra_data, bool randomize_spawn_points = false, bool auto_tick_enabled = false,
+                unsigned tick_threads = 1, size_t tick_profile_depth = 0) 
         : game_(std::move(game))
         , extra_data_(std::move(extra_data))
         , randomize_spawn_points_(randomize_spawn_points)
         , auto_tick_enabled_(auto_tick_enabled)
-        , loot_generator_(loot_gen::LootGenerator(extra_data.base_interval, extra_data.probability)) {
+        , loot_generator_(loot_gen::LootGenerator(extra_data.base_interval, extra_data.probability))
+        , tick_threads_(std::max(1u, tick_threads))
+        , tick_profiler_(tick_profile_depth) {
+        if (tick_threads_ > 1) {
+            tick_pool_ = std::make_unique<net::thread_pool>(tick_threads_ - 1);
+        }
+        SerializeMaps();
     }
 
     Application(const Application&) = delete;
     Application& operator=(const Application&) = delete;
 
 public:
-    json::value GetMapsShortInfo() const noexcept;
-    json::value GetMapInfo(const std::string& map_id) const;
-    json::value GetPlayers(const Players::Token& player_token);
+    // Карты не меняются после загрузки игры, поэтому сериализуются один раз при создании приложения
+    const SerializedJson& GetMapsShortInfo() const noexcept;
+    const SerializedJson& GetMapInfo(std::string_view map_id) const;
+    // Чтение состояния игры не требует синхронизации с тиком: данные берутся из опубликованных снимков сессий
+    json::value GetPlayers(const Players::Token& player_token) const;
     json::value JoinGame(const std::string& user_name, const std::string& map_id);    
-    json::value GetGameState(const Players::Token& player_token);
+    // Состояние сессии сериализуется один раз на версию снимка, результат общий для всех запросов
+    std::shared_ptr<const std::string> GetSerializedGameState(const Players::Token& player_token) const;
+    // Изменения состояния сессии после тика since_tick (или полное состояние, если тик слишком старый)
+    json::value GetGameStateChanges(const Players::Token& player_token, std::uint64_t since_tick) const;
+    // Меняет скорость и направление собаки за O(1), не публикуя снимок: читатели состояния
+    // увидят изменение в снимке, который опубликует ближайший тик
     void ActionPlayer(const Players::Token& player_token, const std::string& direction_str);
 
 public:
     bool GetAutoTick() const noexcept;
     void Tick(std::chrono::milliseconds delta);
+    // Профили последних тиков можно читать из любого потока
+    const tick_profiler::TickProfiler& GetTickProfiler() const noexcept;
 
 private:
+    void SerializeMaps();
+    static SerializedJson MakeSerializedJson(const json::value& value);
+
+    std::shared_ptr<const SessionSnapshot> GetSessionSnapshot(const Players::Token& player_token) const;
+    static json::value GameStateToJson(const SessionSnapshot& session_snapshot);
+    static json::value PlayerStateToJson(const SessionSnapshot::PlayerState& player_state);
+    static json::value LostObjectToJson(const GameSession::LostObject& lost_object);
+
+    // Выполняет action(i) для каждой сессии sessions[i] (параллельно, если есть пул потоков тика)
+    void ForEachSession(const std::vector<GameSession*>& sessions, const std::function<void(size_t)>& action);
+    // phases - длительности этапов обработки сессии (nullptr - без профилирования)
+    void TickSession(GameSession* session, const std::vector<Player*>& players, std::chrono::milliseconds delta,
+                     tick_profiler::PhaseTimes* phases);
     void GenerateMapsLostObjects(std::chrono::milliseconds delta);
 
 private:
@@ -93,6 +145,18 @@ private:
     bool randomize_spawn_points_;
     bool auto_tick_enabled_;
     loot_gen::LootGenerator loot_generator_;
+    unsigned tick_threads_;
+    std::unique_ptr<net::thread_pool> tick_pool_;
+    tick_profiler::TickProfiler tick_profiler_;
+    SerializedJson maps_short_info_;
+    // Прозрачный хеш позволяет искать карту по string_view без создания строки
+    struct MapIdHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view map_id) const noexcept {
+            return std::hash<std::string_view>{}(map_id);
+        }
+    };
+    std::unordered_map<std::string, SerializedJson, MapIdHash, std::equal_to<>> map_id_to_info_;
 };
 
 }  // namespace game_scenarios
@@ -0,0 +1,143 @@
+#include "async_log_sink.h"
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+
+namespace json_logger {
+
+AsyncLogSink::AsyncLogSink(int fd, Options options)
+    : fd_{fd}
+    , overflow_policy_{options.overflow_policy}
+    , mask_{std::bit_ceil(std::max<std::size_t>(options.queue_size, 2)) - 1}
+    , slots_{std::make_unique<Slot[]>(mask_ + 1)} {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer_ = std::thread([this] {
+        Run();
+    });
+}
+
+AsyncLogSink::~AsyncLogSink() {
+    Stop();
+}
+
+void AsyncLogSink::Stop() {
+    if (!writer_.joinable()) {
+        return;
+    }
+    stopping_.store(true, std::memory_order_release);
+    pushed_count_.fetch_add(1, std::memory_order_release);
+    pushed_count_.notify_one();
+    writer_.join();
+}
+
+bool AsyncLogSink::Push(std::string record) {
+    while (true) {
+        const auto released_count = released_count_.load(std::memory_order_acquire);
+        if (TryPush(record)) {
+            pushed_count_.fetch_add(1, std::memory_order_release);
+            pushed_count_.notify_one();
+            return true;
+        }
+        if (overflow_policy_ == OverflowPolicy::Drop) {
+            dropped_count_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        released_count_.wait(released_count, std::memory_order_acquire);
+    }
+}
+
+// Ограниченная очередь Д. Вьюкова: слот захватывается сдвигом enqueue_pos_, готовность записи
+// публикуется через sequence слота
+bool AsyncLogSink::TryPush(std::string& record) {
+    auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots_[pos & mask_];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.record = std::move(record);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // Слот ещё не освобождён читателем: очередь заполнена
+            return false;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLogSink::Run() {
+    while (true) {
+        const auto pushed_count = pushed_count_.load(std::memory_order_acquire);
+        if (WriteBatch() > 0) {
+            continue;
+        }
+        if (stopping_.load(std::memory_order_acquire)) {
+            break;
+        }
+        pushed_count_.wait(pushed_count, std::memory_order_acquire);
+    }
+}
+
+std::size_t AsyncLogSink::WriteBatch() {
+    std::array<iovec, MAX_BATCH_SIZE> iov;
+    std::size_t count = 0;
+    while (count < MAX_BATCH_SIZE) {
+        Slot& slot = slots_[(dequeue_pos_ + count) & mask_];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + count + 1) {
+            break;
+        }
+        iov[count].iov_base = slot.record.data();
+        iov[count].iov_len = slot.record.size();
+        ++count;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    // Записи выводятся прямо из слотов, поэтому слоты освобождаются только после вывода
+    iovec* first = iov.data();
+    int remaining = static_cast<int>(count);
+    while (remaining > 0) {
+        const auto written = ::writev(fd_, first, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Вывод недоступен: записи теряются, как и при переполнении очереди
+            dropped_count_.fetch_add(remaining, std::memory_order_relaxed);
+            break;
+        }
+        auto written_size = static_cast<std::size_t>(written);
+        while (remaining > 0 && written_size >= first->iov_len) {
+            written_size -= first->iov_len;
+            ++first;
+            --remaining;
+        }
+        if (remaining > 0) {
+            first->iov_base = static_cast<char*>(first->iov_base) + written_size;
+            first->iov_len -= written_size;
+        }
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        Slot& slot = slots_[dequeue_pos_ & mask_];
+        slot.record.clear();
+        slot.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+        ++dequeue_pos_;
+    }
+    released_count_.fetch_add(1, std::memory_order_release);
+    released_count_.notify_all();
+    return count;
+}
+
+}  // namespace json_logger
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace json_logger {
+
+// Что делать с записью, если очередь лога заполнена
+enum class OverflowPolicy {
+    // Запись отбрасывается и учитывается в счётчике отброшенных
+    Drop,
+    // Пишущий поток ждёт, пока фоновый поток освободит место
+    Block
+};
+
+/*
+ * Асинхронный вывод готовых (отформатированных) записей лога.
+ * Записи помещаются в ограниченную lock-free очередь (много писателей, один читатель),
+ * фоновый поток забирает их пачками и выводит одним вызовом writev.
+ * Push можно вызывать из любых потоков. Деструктор дожидается вывода всех помещённых в очередь записей
+ */
+class AsyncLogSink {
+public:
+    struct Options {
+        // Округляется вверх до степени двойки
+        std::size_t queue_size = 8192;
+        OverflowPolicy overflow_policy = OverflowPolicy::Drop;
+    };
+
+    AsyncLogSink(int fd, Options options);
+    ~AsyncLogSink();
+
+    AsyncLogSink(const AsyncLogSink&) = delete;
+    AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+
+    // Запись должна оканчиваться переводом строки. Возвращает false, если запись отброшена
+    bool Push(std::string record);
+
+    // Выводит записи, уже помещённые в очередь, и останавливает фоновый поток. Вызывается после последнего Push
+    void Stop();
+
+    std::uint64_t GetDroppedCount() const noexcept {
+        return dropped_count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        // Номер позиции, для которой слот свободен (pos) или заполнен (pos + 1)
+        std::atomic<std::size_t> sequence;
+        std::string record;
+    };
+
+    // Максимальное количество записей в одном вызове writev
+    static constexpr std::size_t MAX_BATCH_SIZE = 64;
+
+    bool TryPush(std::string& record);
+    void Run();
+    // Выводит готовые записи из головы очереди и освобождает их слоты, возвращает количество выведенных
+    std::size_t WriteBatch();
+
+private:
+    const int fd_;
+    const OverflowPolicy overflow_policy_;
+    const std::size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<std::size_t> enqueue_pos_{0};
+    // Увеличивается после каждой записи в очередь, на нём ждёт фоновый поток
+    alignas(64) std::atomic<std::uint32_t> pushed_count_{0};
+    // Увеличивается после освобождения слотов, на нём ждут писатели при политике Block
+    alignas(64) std::atomic<std::uint32_t> released_count_{0};
+    std::atomic<std::uint64_t> dropped_count_{0};
+    std::atomic<bool> stopping_{false};
+
+    // Используется только фоновым потоком
+    std::size_t dequeue_pos_ = 0;
+    std::thread writer_;
+};
+
+}  // namespace json_logger
@@ -1,5 +1,10 @@
 #include "collision_detector.h"
 #include <cassert>
+#include <cmath>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
 
 namespace collision_detector {
 
@@ -22,41 +27,308 @@ CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D
     return CollectionResult(sq_distance, proj_ratio);
 }
 
-// В задании на разработку тестов реализовывать следующую функцию не нужно -
-// она будет линковаться извне.
-std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
-    std::vector<GatheringEvent> detected_events;
+namespace {
 
-    static auto eq_pt = [](geom::Point2D p1, geom::Point2D p2) {
-        return p1.x == p2.x && p1.y == p2.y;
-    };
+// Равномерная сетка по предметам. Координаты и ширины предметов хранятся в порядке ячеек,
+// поэтому предметы соседних ячеек одной строки лежат в массивах подряд.
+class ItemGrid {
+public:
+    explicit ItemGrid(const ItemSpans& items) {
+        const size_t item_count = items.xs.size();
+        if (item_count == 0) {
+            return;
+        }
 
-    for (size_t g = 0; g < provider.GatherersCount(); ++g) {
-        Gatherer gatherer = provider.GetGatherer(g);
-        if (eq_pt(gatherer.start_pos, gatherer.end_pos)) {
-            continue;
+        const auto [min_x, max_x] = std::minmax_element(items.xs.begin(), items.xs.end());
+        const auto [min_y, max_y] = std::minmax_element(items.ys.begin(), items.ys.end());
+        min_x_ = *min_x;
+        max_x_ = *max_x;
+        min_y_ = *min_y;
+        max_y_ = *max_y;
+
+        // Размер ячейки подбираем так, чтобы на ячейку в среднем приходилось около одного предмета
+        const double area = std::max(max_x_ - min_x_, MIN_CELL_SIZE) * std::max(max_y_ - min_y_, MIN_CELL_SIZE);
+        cell_size_ = std::max(std::sqrt(area / static_cast<double>(item_count)), MIN_CELL_SIZE);
+        width_ = static_cast<size_t>((max_x_ - min_x_) / cell_size_) + 1;
+        height_ = static_cast<size_t>((max_y_ - min_y_) / cell_size_) + 1;
+
+        // Раскладываем предметы по ячейкам подсчётом
+        cell_starts_.assign(width_ * height_ + 1, 0);
+        std::vector<size_t> item_cells(item_count);
+        for (size_t i = 0; i < item_count; ++i) {
+            item_cells[i] = CellIndex(CellX(items.xs[i]), CellY(items.ys[i]));
+            ++cell_starts_[item_cells[i] + 1];
+        }
+        for (size_t cell = 1; cell < cell_starts_.size(); ++cell) {
+            cell_starts_[cell] += cell_starts_[cell - 1];
+        }
+        ids_.resize(item_count);
+        xs_.resize(item_count);
+        ys_.resize(item_count);
+        widths_.resize(item_count);
+        std::vector<size_t> cell_fill(cell_starts_.begin(), cell_starts_.end() - 1);
+        for (size_t i = 0; i < item_count; ++i) {
+            const size_t slot = cell_fill[item_cells[i]]++;
+            ids_[slot] = i;
+            xs_[slot] = items.xs[i];
+            ys_[slot] = items.ys[i];
+            widths_[slot] = items.widths[i];
         }
-        for (size_t i = 0; i < provider.ItemsCount(); ++i) {
-            Item item = provider.GetItem(i);
-            auto collect_result
-                = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
-
-            if (collect_result.IsCollected(gatherer.width + item.width)) {
-                GatheringEvent evt{.item_id = i,
-                                   .gatherer_id = g,
-                                   .sq_distance = collect_result.sq_distance,
-                                   .time = collect_result.proj_ratio};
-                detected_events.push_back(evt);
+        max_item_width_ = *std::max_element(widths_.begin(), widths_.end());
+    }
+
+    double GetMaxItemWidth() const noexcept {
+        return max_item_width_;
+    }
+
+    // Вызывает action(begin, end) для каждого диапазона слотов, предметы которого могут оказаться
+    // не дальше margin от отрезка (ax, ay) - (bx, by)
+    template <typename Action>
+    void ForEachCandidateRange(double ax, double ay, double bx, double by, double margin, Action&& action) const {
+        if (ids_.empty()) {
+            return;
+        }
+
+        const double left = std::min(ax, bx) - margin;
+        const double right = std::max(ax, bx) + margin;
+        const double top = std::min(ay, by) - margin;
+        const double bottom = std::max(ay, by) + margin;
+        if (right < min_x_ || left > max_x_ || bottom < min_y_ || top > max_y_) {
+            return;
+        }
+
+        const size_t x_begin = CellX(left);
+        const size_t x_end = CellX(right);
+        const size_t y_end = CellY(bottom);
+        for (size_t y = CellY(top); y <= y_end; ++y) {
+            const size_t begin = cell_starts_[CellIndex(x_begin, y)];
+            const size_t end = cell_starts_[CellIndex(x_end, y) + 1];
+            if (begin != end) {
+                action(begin, end);
             }
         }
     }
 
+    size_t GetItemId(size_t slot) const {
+        return ids_[slot];
+    }
+    const double* GetXs() const noexcept {
+        return xs_.data();
+    }
+    const double* GetYs() const noexcept {
+        return ys_.data();
+    }
+    const double* GetWidths() const noexcept {
+        return widths_.data();
+    }
+
+private:
+    static constexpr double MIN_CELL_SIZE = 1.0;
+
+    size_t CellX(double x) const {
+        return ToCell(x - min_x_, width_);
+    }
+    size_t CellY(double y) const {
+        return ToCell(y - min_y_, height_);
+    }
+    size_t ToCell(double offset, size_t cell_count) const {
+        if (offset <= 0) {
+            return 0;
+        }
+        return std::min(static_cast<size_t>(offset / cell_size_), cell_count - 1);
+    }
+    size_t CellIndex(size_t x, size_t y) const {
+        return y * width_ + x;
+    }
+
+    double min_x_ = 0;
+    double max_x_ = 0;
+    double min_y_ = 0;
+    double max_y_ = 0;
+    double cell_size_ = MIN_CELL_SIZE;
+    double max_item_width_ = 0;
+    size_t width_ = 0;
+    size_t height_ = 0;
+
+    // Ячейки хранятся построчно: предметы ячейки cell занимают слоты [cell_starts_[cell], cell_starts_[cell + 1])
+    std::vector<size_t> cell_starts_;
+    std::vector<size_t> ids_;
+    std::vector<double> xs_;
+    std::vector<double> ys_;
+    std::vector<double> widths_;
+};
+
+// Запас на погрешность вычисления расстояния в TryCollectPoint
+constexpr double CANDIDATE_MARGIN_EPSILON = 1e-6;
+
+// Точная проверка предметов из слотов [begin, end) сетки для собирателя gatherer_id.
+// Вычисления повторяют TryCollectPoint операция в операцию, поэтому результат не зависит от ширины пачки.
+class SegmentCollector {
+public:
+    SegmentCollector(const ItemGrid& grid, size_t gatherer_id, double ax, double ay, double bx, double by,
+                     double width, std::vector<GatheringEvent>& events)
+        : grid_(grid)
+        , gatherer_id_(gatherer_id)
+        , ax_(ax)
+        , ay_(ay)
+        , bx_(bx)
+        , by_(by)
+        , v_x_(bx - ax)
+        , v_y_(by - ay)
+        , v_len2_(v_x_ * v_x_ + v_y_ * v_y_)
+        , width_(width)
+        , events_(events) {
+    }
+
+    void operator()(size_t begin, size_t end) const {
+        size_t slot = begin;
+#ifdef __AVX__
+        slot = CollectAvx(begin, end);
+#endif
+        for (; slot < end; ++slot) {
+            CollectOne(slot);
+        }
+    }
+
+private:
+    void CollectOne(size_t slot) const {
+        const auto result = TryCollectPoint({ax_, ay_}, {bx_, by_}, {grid_.GetXs()[slot], grid_.GetYs()[slot]});
+        if (result.IsCollected(width_ + grid_.GetWidths()[slot])) {
+            AddEvent(slot, result);
+        }
+    }
+
+    void AddEvent(size_t slot, const CollectionResult& result) const {
+        events_.push_back(GatheringEvent{.item_id = grid_.GetItemId(slot),
+                                         .gatherer_id = gatherer_id_,
+                                         .sq_distance = result.sq_distance,
+                                         .time = result.proj_ratio});
+    }
+
+#ifdef __AVX__
+    // Проверяет пачки по 4 предмета, возвращает первый непроверенный слот
+    size_t CollectAvx(size_t begin, size_t end) const {
+        const __m256d ax = _mm256_set1_pd(ax_);
+        const __m256d ay = _mm256_set1_pd(ay_);
+        const __m256d v_x = _mm256_set1_pd(v_x_);
+        const __m256d v_y = _mm256_set1_pd(v_y_);
+        const __m256d v_len2 = _mm256_set1_pd(v_len2_);
+        const __m256d width = _mm256_set1_pd(width_);
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d one = _mm256_set1_pd(1.0);
+
+        alignas(32) double sq_distances[4];
+        alignas(32) double proj_ratios[4];
+        size_t slot = begin;
+        for (; slot + 4 <= end; slot += 4) {
+            const __m256d u_x = _mm256_sub_pd(_mm256_loadu_pd(grid_.GetXs() + slot), ax);
+            const __m256d u_y = _mm256_sub_pd(_mm256_loadu_pd(grid_.GetYs() + slot), ay);
+            const __m256d u_dot_v = _mm256_add_pd(_mm256_mul_pd(u_x, v_x), _mm256_mul_pd(u_y, v_y));
+            const __m256d u_len2 = _mm256_add_pd(_mm256_mul_pd(u_x, u_x), _mm256_mul_pd(u_y, u_y));
+            const __m256d proj_ratio = _mm256_div_pd(u_dot_v, v_len2);
+            const __m256d sq_distance
+                = _mm256_sub_pd(u_len2, _mm256_div_pd(_mm256_mul_pd(u_dot_v, u_dot_v), v_len2));
+            const __m256d collect_radius = _mm256_add_pd(width, _mm256_loadu_pd(grid_.GetWidths() + slot));
+
+            const __m256d collected = _mm256_and_pd(
+                _mm256_and_pd(_mm256_cmp_pd(proj_ratio, zero, _CMP_GE_OQ), _mm256_cmp_pd(proj_ratio, one, _CMP_LE_OQ)),
+                _mm256_cmp_pd(sq_distance, _mm256_mul_pd(collect_radius, collect_radius), _CMP_LE_OQ));
+            int mask = _mm256_movemask_pd(collected);
+            if (mask == 0) {
+                continue;
+            }
+
+            _mm256_store_pd(sq_distances, sq_distance);
+            _mm256_store_pd(proj_ratios, proj_ratio);
+            for (size_t lane = 0; lane < 4; ++lane) {
+                if (mask & (1 << lane)) {
+                    AddEvent(slot + lane, CollectionResult{sq_distances[lane], proj_ratios[lane]});
+                }
+            }
+        }
+        return slot;
+    }
+#endif
+
+    const ItemGrid& grid_;
+    size_t gatherer_id_;
+    double ax_;
+    double ay_;
+    double bx_;
+    double by_;
+    double v_x_;
+    double v_y_;
+    double v_len2_;
+    double width_;
+    std::vector<GatheringEvent>& events_;
+};
+
+}  // namespace
+
+std::vector<GatheringEvent> FindGatherEvents(const ItemSpans& items, const GathererSpans& gatherers) {
+    std::vector<GatheringEvent> detected_events;
+
+    // Широкая фаза: точную проверку проходят только предметы из ячеек,
+    // которые пересекает описывающий прямоугольник пути собирателя
+    const ItemGrid item_grid(items);
+    for (size_t g = 0; g < gatherers.start_xs.size(); ++g) {
+        const double ax = gatherers.start_xs[g];
+        const double ay = gatherers.start_ys[g];
+        const double bx = gatherers.end_xs[g];
+        const double by = gatherers.end_ys[g];
+        if (ax == bx && ay == by) {
+            continue;
+        }
+        const double width = gatherers.widths[g];
+        item_grid.ForEachCandidateRange(ax, ay, bx, by, width + item_grid.GetMaxItemWidth() + CANDIDATE_MARGIN_EPSILON,
+                                        SegmentCollector(item_grid, g, ax, ay, bx, by, width, detected_events));
+    }
+
+    // События упорядочены по времени, одновременные - по собирателю и предмету
     std::sort(detected_events.begin(), detected_events.end(),
               [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
-                  return e_l.time < e_r.time;
+                  if (e_l.time != e_r.time) {
+                      return e_l.time < e_r.time;
+                  }
+                  if (e_l.gatherer_id != e_r.gatherer_id) {
+                      return e_l.gatherer_id < e_r.gatherer_id;
+                  }
+                  return e_l.item_id < e_r.item_id;
               });
 
     return detected_events;
 }
 
-}  // namespace collision_detector
\ No newline at end of file
+// В задании на разработку тестов реализовывать следующую функцию не нужно -
+// она будет линковаться извне.
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
+    // Переводим данные провайдера в структуру массивов
+    std::vector<double> item_xs(provider.ItemsCount());
+    std::vector<double> item_ys(provider.ItemsCount());
+    std::vector<double> item_widths(provider.ItemsCount());
+    for (size_t i = 0; i < provider.ItemsCount(); ++i) {
+        Item item = provider.GetItem(i);
+        item_xs[i] = item.position.x;
+        item_ys[i] = item.position.y;
+        item_widths[i] = item.width;
+    }
+
+    std::vector<double> start_xs(provider.GatherersCount());
+    std::vector<double> start_ys(provider.GatherersCount());
+    std::vector<double> end_xs(provider.GatherersCount());
+    std::vector<double> end_ys(provider.GatherersCount());
+    std::vector<double> gatherer_widths(provider.GatherersCount());
+    for (size_t g = 0; g < provider.GatherersCount(); ++g) {
+        Gatherer gatherer = provider.GetGatherer(g);
+        start_xs[g] = gatherer.start_pos.x;
+        start_ys[g] = gatherer.start_pos.y;
+        end_xs[g] = gatherer.end_pos.x;
+        end_ys[g] = gatherer.end_pos.y;
+        gatherer_widths[g] = gatherer.width;
+    }
+
+    return FindGatherEvents(ItemSpans{item_xs, item_ys, item_widths},
+                            GathererSpans{start_xs, start_ys, end_xs, end_ys, gatherer_widths});
+}
+
+}  // namespace collision_detector
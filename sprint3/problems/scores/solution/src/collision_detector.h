@@ -3,6 +3,7 @@
 #include "geom.h"
 
 #include <algorithm>
+#include <span>
 #include <vector>
 
 namespace collision_detector {
@@ -80,6 +81,26 @@ private:
     const std::vector<Item>& items_;
 };
 
+// Предметы в виде структуры массивов: i-й предмет - (xs[i], ys[i]) с шириной widths[i]
+struct ItemSpans {
+    std::span<const double> xs;
+    std::span<const double> ys;
+    std::span<const double> widths;
+};
+
+// Собиратели в виде структуры массивов: i-й собиратель движется из (start_xs[i], start_ys[i])
+// в (end_xs[i], end_ys[i]) и имеет ширину widths[i]
+struct GathererSpans {
+    std::span<const double> start_xs;
+    std::span<const double> start_ys;
+    std::span<const double> end_xs;
+    std::span<const double> end_ys;
+    std::span<const double> widths;
+};
+
+// Поиск событий без виртуальных вызовов: предметы проверяются пачками (по 4 при сборке с AVX)
+std::vector<GatheringEvent> FindGatherEvents(const ItemSpans& items, const GathererSpans& gatherers);
+
 // Эту функцию вам нужно будет реализовать в соответствующем задании.
 // При проверке ваших тестов она не нужна - функция будет линковаться снаружи.
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
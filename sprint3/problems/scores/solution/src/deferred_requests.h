@@ -0,0 +1,82 @@
+#pragma once
+
+#include <boost/asio/dispatch.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace http_server {
+
+/*
+ * Запросы одного соединения, обработка которых отложена в другой исполнитель (например, в strand API).
+ * При конвейерной обработке следующий запрос соединения читается, пока предыдущие ещё ждут своей очереди,
+ * и не должен их обгонять: пока есть отложенные запросы, следующие откладываются в тот же исполнитель.
+ * Методы можно вызывать из любых потоков
+ */
+class DeferredRequests : public std::enable_shared_from_this<DeferredRequests> {
+public:
+    // Отметка отложенного запроса, снимается при разрушении (после обработки запроса)
+    class Mark {
+    public:
+        Mark() = default;
+
+        explicit Mark(std::shared_ptr<DeferredRequests> requests) noexcept
+            : requests_(std::move(requests)) {
+            requests_->count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Mark(Mark&&) noexcept = default;
+        Mark& operator=(Mark&& other) noexcept {
+            if (this != &other) {
+                Release();
+                requests_ = std::move(other.requests_);
+            }
+            return *this;
+        }
+
+        ~Mark() {
+            Release();
+        }
+
+    private:
+        void Release() noexcept {
+            if (requests_) {
+                // release: результат обработки запроса виден тому, кто увидит, что отложенных запросов не осталось
+                requests_->count_.fetch_sub(1, std::memory_order_release);
+                requests_.reset();
+            }
+        }
+
+        std::shared_ptr<DeferredRequests> requests_;
+    };
+
+    bool IsEmpty() const noexcept {
+        return count_.load(std::memory_order_acquire) == 0;
+    }
+
+    // Откладывает обработку запроса в executor. Запрос считается отложенным, пока handler не завершится
+    template <typename Executor, typename Handler>
+    void Defer(const Executor& executor, Handler&& handler) {
+        boost::asio::dispatch(executor, [mark = Mark{shared_from_this()}, handler = std::forward<Handler>(handler)]() mutable {
+            handler();
+        });
+    }
+
+    // Обрабатывает запрос сразу, если предыдущие запросы соединения не отложены, иначе откладывает его вслед за ними.
+    // Исполнитель должен обрабатывать задачи в порядке поступления (strand)
+    template <typename Executor, typename Handler>
+    void RunInOrder(const Executor& executor, Handler&& handler) {
+        if (IsEmpty()) {
+            handler();
+        } else {
+            Defer(executor, std::forward<Handler>(handler));
+        }
+    }
+
+private:
+    std::atomic<std::size_t> count_{0};
+};
+
+}  // namespace http_server
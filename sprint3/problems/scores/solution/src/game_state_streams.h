@@ -0,0 +1,70 @@
+#pragma once
+
+#include "application.h"
+#include "http_server.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace http_handler {
+
+/*
+ * Подписчики на рассылку состояния игры по WebSocket.
+ * Каждый подписчик получает состояние своей сессии не чаще одного раза за тик и только если оно изменилось.
+ * Сериализованное состояние общее для всех игроков сессии (см. Application::GetSerializedGameState).
+ * Методы класса вызываются только внутри strand-а API, поэтому синхронизация не нужна
+ */
+class GameStateStreams {
+public:
+    using Token = players::Players::Token;
+    using Stream = http_server::WebSocketSession;
+
+    explicit GameStateStreams(game_scenarios::Application& app)
+        : app_{app} {
+    }
+
+    GameStateStreams(const GameStateStreams&) = delete;
+    GameStateStreams& operator=(const GameStateStreams&) = delete;
+
+    void Subscribe(const Token& token, std::shared_ptr<Stream> stream) {
+        auto& subscriber = subscribers_.emplace_back(Subscriber{token, stream, nullptr});
+        SendState(subscriber, *stream);
+    }
+
+    // Рассылает подписчикам текущее состояние их сессий, закрытые соединения удаляются
+    void Push() {
+        std::erase_if(subscribers_, [this](Subscriber& subscriber) {
+            auto stream = subscriber.stream.lock();
+            return !stream || stream->IsClosed() || !SendState(subscriber, *stream);
+        });
+    }
+
+private:
+    struct Subscriber {
+        Token token;
+        std::weak_ptr<Stream> stream;
+        // Последнее отправленное состояние: новая версия снимка - новая строка
+        std::shared_ptr<const std::string> last_state;
+    };
+
+    bool SendState(Subscriber& subscriber, Stream& stream) {
+        std::shared_ptr<const std::string> state;
+        try {
+            state = app_.GetSerializedGameState(subscriber.token);
+        } catch (const game_scenarios::AppErrorException&) {
+            return false;
+        }
+        if (state != subscriber.last_state) {
+            subscriber.last_state = state;
+            stream.Send(std::move(state));
+        }
+        return true;
+    }
+
+private:
+    game_scenarios::Application& app_;
+    std::vector<Subscriber> subscribers_;
+};
+
+}  // namespace http_handler
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+namespace http_server {
+
+/*
+ * Память соединения для обработчиков асинхронных операций и отправляемых ответов.
+ * У соединения одновременно выполняется лишь несколько операций, поэтому несколько блоков
+ * переиспользуются от запроса к запросу. Если свободного блока нет или запрошено больше BLOCK_SIZE,
+ * память выделяется из кучи.
+ * Блоки захватываются атомарно, поэтому выделять и освобождать память можно из разных потоков
+ */
+class HandlerMemory {
+public:
+    static constexpr std::size_t BLOCK_SIZE = 2048;
+    static constexpr std::size_t BLOCK_COUNT = 4;
+
+    HandlerMemory() = default;
+
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* Allocate(std::size_t size) {
+        if (size <= BLOCK_SIZE) {
+            for (std::size_t i = 0; i < BLOCK_COUNT; ++i) {
+                if (!in_use_[i].load(std::memory_order_relaxed) && !in_use_[i].exchange(true, std::memory_order_acquire)) {
+                    return blocks_[i].data;
+                }
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void Deallocate(void* pointer) noexcept {
+        for (std::size_t i = 0; i < BLOCK_COUNT; ++i) {
+            if (pointer == blocks_[i].data) {
+                in_use_[i].store(false, std::memory_order_release);
+                return;
+            }
+        }
+        ::operator delete(pointer);
+    }
+
+private:
+    struct alignas(std::max_align_t) Block {
+        std::byte data[BLOCK_SIZE];
+    };
+
+    std::array<Block, BLOCK_COUNT> blocks_;
+    std::array<std::atomic<bool>, BLOCK_COUNT> in_use_{};
+};
+
+// Аллокатор, выделяющий память из HandlerMemory. Память должна жить дольше всех выделенных из неё объектов
+template <typename T>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& memory) noexcept
+        : memory_(&memory) {
+    }
+
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept
+        : memory_(other.memory_) {
+    }
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(memory_->Allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* pointer, std::size_t) noexcept {
+        memory_->Deallocate(pointer);
+    }
+
+    template <typename U>
+    bool operator==(const HandlerAllocator<U>& other) const noexcept {
+        return memory_ == other.memory_;
+    }
+
+private:
+    template <typename>
+    friend class HandlerAllocator;
+
+    HandlerMemory* memory_;
+};
+
+}  // namespace http_server
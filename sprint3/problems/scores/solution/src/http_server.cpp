@@ -2,6 +2,7 @@
 #include "json_logger.h"
 
 #include <boost/asio/dispatch.hpp>
+#include <boost/asio/write.hpp>
 #include <iostream>
 
 namespace http_server {
@@ -9,10 +10,165 @@ void ReportError(beast::error_code ec, std::string_view what) {
     json_logger::LogData("error"sv, boost::json::object{{"code", ec.value()}, {"text", ec.message()}, {"where", what}});
 }
 
+namespace {
+
+std::atomic<std::uint64_t> rejected_connection_count{0};
+
+int HexDigitValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Обработчик ищет параметры по декодированному имени, поэтому и здесь имя сравнивается
+// после декодирования: %74oken тоже считается параметром token
+bool IsTokenParamName(std::string_view name) {
+    constexpr auto token_name = "token"sv;
+    size_t matched = 0;
+    for (size_t i = 0; i < name.size(); ++i) {
+        char c = name[i];
+        if (c == '%' && i + 2 < name.size() && HexDigitValue(name[i + 1]) >= 0 && HexDigitValue(name[i + 2]) >= 0) {
+            c = static_cast<char>(HexDigitValue(name[i + 1]) * 16 + HexDigitValue(name[i + 2]));
+            i += 2;
+        }
+        if (matched == token_name.size() || token_name[matched] != c) {
+            return false;
+        }
+        ++matched;
+    }
+    return matched == token_name.size();
+}
+
+}  // namespace
+
+std::string RedactTarget(std::string_view target) {
+    const auto query_start = target.find('?');
+    if (query_start == std::string_view::npos) {
+        return std::string(target);
+    }
+    std::string redacted(target.substr(0, query_start + 1));
+    auto query = target.substr(query_start + 1);
+    while (true) {
+        const auto param_end = query.find('&');
+        const auto param = query.substr(0, param_end);
+        const auto name_end = param.find('=');
+        if (name_end != std::string_view::npos && IsTokenParamName(param.substr(0, name_end))) {
+            redacted.append(param.substr(0, name_end + 1)).append("***"sv);
+        } else {
+            redacted.append(param);
+        }
+        if (param_end == std::string_view::npos) {
+            return redacted;
+        }
+        redacted.push_back('&');
+        query.remove_prefix(param_end + 1);
+    }
+}
+
+void RejectConnection(ConnectionSocket&& socket, std::shared_ptr<const std::string> response) {
+    rejected_connection_count.fetch_add(1, std::memory_order_relaxed);
+    auto safe_socket = std::make_shared<ConnectionSocket>(std::move(socket));
+    auto buffer = net::buffer(*response);
+    net::async_write(*safe_socket, buffer, [safe_socket, response = std::move(response)](beast::error_code ec, std::size_t) {
+        // Ответ отклонённому клиенту не важен, ошибки не логируем, чтобы не нагружать перегруженный сервер
+        safe_socket->shutdown(tcp::socket::shutdown_both, ec);
+        safe_socket->close(ec);
+    });
+}
+
+std::uint64_t GetRejectedConnectionCount() noexcept {
+    return rejected_connection_count.load(std::memory_order_relaxed);
+}
+
 void SessionBase::Run() {
     // Вызываем метод Read, используя executor объекта stream_.
     // Таким образом вся работа со stream_ будет выполняться, используя его executor
     net::dispatch(stream_.get_executor(), beast::bind_front_handler(&SessionBase::Read, GetSharedThis()));
 }
 
+void WebSocketSession::Run(http::request<http::string_body>&& upgrade_request, OnOpen on_open) {
+    // Таймауты HTTP-сессии больше не действуют, за соединением следит websocket::stream
+    beast::get_lowest_layer(ws_).expires_never();
+    ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+    ws_.text(true);
+
+    // Запрос должен жить до окончания рукопожатия
+    upgrade_request_ = std::move(upgrade_request);
+    net::dispatch(ws_.get_executor(), [self = shared_from_this(), on_open = std::move(on_open)]() mutable {
+        self->ws_.async_accept(self->upgrade_request_,
+                               [self, on_open = std::move(on_open)](beast::error_code ec) {
+                                   self->OnAccept(on_open, ec);
+                               });
+    });
+}
+
+void WebSocketSession::OnAccept(const OnOpen& on_open, beast::error_code ec) {
+    upgrade_request_ = {};
+    if (ec) {
+        closed_ = true;
+        return ReportError(ec, "websocket accept"sv);
+    }
+    on_open(shared_from_this());
+    Read();
+}
+
+void WebSocketSession::Read() {
+    ws_.async_read(read_buffer_, beast::bind_front_handler(&WebSocketSession::OnRead, shared_from_this()));
+}
+
+void WebSocketSession::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+    if (ec) {
+        closed_ = true;
+        if (ec != websocket::error::closed) {
+            ReportError(ec, "websocket read"sv);
+        }
+        return;
+    }
+    read_buffer_.clear();
+    Read();
+}
+
+void WebSocketSession::Send(std::shared_ptr<const std::string> frame) {
+    net::post(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+        self->OnSend(std::move(frame));
+    });
+}
+
+void WebSocketSession::OnSend(std::shared_ptr<const std::string>&& frame) {
+    if (IsClosed()) {
+        return;
+    }
+    if (writing_frame_) {
+        // Промежуточный кадр отбрасывается
+        pending_frame_ = std::move(frame);
+        return;
+    }
+    Write(std::move(frame));
+}
+
+void WebSocketSession::Write(std::shared_ptr<const std::string>&& frame) {
+    writing_frame_ = std::move(frame);
+    ws_.async_write(net::buffer(*writing_frame_),
+                    beast::bind_front_handler(&WebSocketSession::OnWrite, shared_from_this()));
+}
+
+void WebSocketSession::OnWrite(beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+    writing_frame_.reset();
+    if (ec) {
+        closed_ = true;
+        pending_frame_.reset();
+        return ReportError(ec, "websocket write"sv);
+    }
+    if (pending_frame_) {
+        Write(std::exchange(pending_frame_, nullptr));
+    }
+}
+
 }  // namespace http_server
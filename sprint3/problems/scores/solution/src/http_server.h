@@ -1,15 +1,30 @@
 #pragma once
 #include "sdk.h"
+#include "deferred_requests.h"
+#include "handler_memory.h"
 #include "json_logger.h"
 
 // boost.beast будет использовать std::string_view вместо boost::string_view
 #define BOOST_BEAST_USE_STD_STRING_VIEW
 
 #include <boost/algorithm/string.hpp>
+#include <boost/asio/bind_allocator.hpp>
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 namespace http_server {
 
@@ -18,15 +33,118 @@ using tcp = net::ip::tcp;
 using namespace std::literals;
 namespace beast = boost::beast;
 namespace http = beast::http;
+namespace websocket = beast::websocket;
+
+// Соединения работают в своих strand-ах. Конкретный тип исполнителя вместо any_io_executor
+// не требует выделения памяти при каждой передаче исполнителя в асинхронную операцию
+using ConnectionStrand = net::strand<net::io_context::executor_type>;
+using ConnectionSocket = tcp::socket::rebind_executor<ConnectionStrand>::other;
+using ConnectionStream = beast::basic_stream<tcp, ConnectionStrand>;
 
 void ReportError(beast::error_code ec, std::string_view what);
+// Цель запроса для журнала: значение параметра token заменяется на ***, чтобы токен игрока не попал в логи
+std::string RedactTarget(std::string_view target);
+
+struct ServerOptions {
+    // Максимальное количество запросов соединения, ожидающих отправки ответа
+    std::size_t pipeline_depth = 1;
+    // Разрешает нескольким серверам слушать один порт (SO_REUSEPORT)
+    bool reuse_port = false;
+    // Максимальное количество открытых соединений (0 - без ограничения).
+    // Сверх него соединение получает 503 Service Unavailable и закрывается
+    std::size_t max_connections = 0;
+    // Значение заголовка Retry-After для отклонённых соединений
+    std::chrono::seconds retry_after{1};
+};
+
+using ReusePort = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+// Учёт открытых соединений: объект живёт столько же, сколько соединение
+class OpenConnection {
+public:
+    OpenConnection() noexcept {
+        count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~OpenConnection() {
+        count_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    OpenConnection(const OpenConnection&) = delete;
+    OpenConnection& operator=(const OpenConnection&) = delete;
+
+    // Количество открытых HTTP и WebSocket соединений
+    static std::int64_t GetCount() noexcept {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static inline std::atomic<std::int64_t> count_{0};
+};
+
+// Отправляет готовый ответ (обычно 503 Service Unavailable) и закрывает соединение, не читая запрос
+void RejectConnection(ConnectionSocket&& socket, std::shared_ptr<const std::string> response);
+
+// Количество соединений, отклонённых из-за ограничения max_connections
+std::uint64_t GetRejectedConnectionCount() noexcept;
+
+// WebSocket-соединение, через которое сервер рассылает клиенту кадры
+class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
+public:
+    using OnOpen = std::function<void(std::shared_ptr<WebSocketSession>)>;
+
+    explicit WebSocketSession(ConnectionStream&& stream)
+        : ws_(std::move(stream)) {
+    }
+
+    WebSocketSession(const WebSocketSession&) = delete;
+    WebSocketSession& operator=(const WebSocketSession&) = delete;
+
+    // Завершает рукопожатие по запросу upgrade_request, после чего вызывает on_open
+    void Run(http::request<http::string_body>&& upgrade_request, OnOpen on_open);
 
+    // Можно вызывать из любого потока. Пока предыдущий кадр не отправлен, новый кадр замещает ожидающий:
+    // медленный клиент получает только последнее состояние, а очередь не растёт
+    void Send(std::shared_ptr<const std::string> frame);
+
+    bool IsClosed() const noexcept {
+        return closed_.load(std::memory_order_relaxed);
+    }
+
+private:
+    void OnAccept(const OnOpen& on_open, beast::error_code ec);
+    void Read();
+    void OnRead(beast::error_code ec, std::size_t bytes_read);
+    void OnSend(std::shared_ptr<const std::string>&& frame);
+    void Write(std::shared_ptr<const std::string>&& frame);
+    void OnWrite(beast::error_code ec, std::size_t bytes_written);
+
+private:
+    websocket::stream<ConnectionStream> ws_;
+    http::request<http::string_body> upgrade_request_;
+    // Входящие сообщения клиента не используются, читаем их только для обработки ping и close
+    beast::flat_buffer read_buffer_;
+    std::shared_ptr<const std::string> writing_frame_;
+    std::shared_ptr<const std::string> pending_frame_;
+    std::atomic<bool> closed_{false};
+    OpenConnection open_connection_;
+};
+
+class ResponseSender;
+class WebSocketUpgrade;
+
+/*
+ * HTTP-сессия. Пока обрабатываются и отправляются предыдущие запросы, сессия может читать следующие
+ * (HTTP/1.1 pipelining), но не более pipeline_depth необработанных запросов. Ответы готовятся в любом
+ * порядке и в любых потоках, а отправляются в порядке запросов.
+ * При pipeline_depth == 1 следующий запрос читается только после отправки ответа на предыдущий
+ */
 class SessionBase {
 protected:
     using HttpRequest = http::request<http::string_body>;
     
-    explicit SessionBase(tcp::socket&& socket)
-        : stream_(std::move(socket)) {
+    SessionBase(ConnectionSocket&& socket, std::size_t pipeline_depth)
+        : stream_(std::move(socket))
+        , pending_responses_(std::max<std::size_t>(pipeline_depth, 1)) {
     }
 
     ~SessionBase() = default;
@@ -39,84 +157,258 @@ public:
     void Run();
 
 private:
+    friend class ResponseSender;
+    friend class WebSocketUpgrade;
+
+    // Готовый к отправке ответ, тип которого известен только в Write
+    struct PendingResponse {
+        std::shared_ptr<void> response;
+        void (*async_write)(SessionBase& session, void* response) = nullptr;
+    };
+
+    // Ответ вместе с объектом, который должен жить до окончания отправки ответа
+    template <typename Response, typename Attachment>
+    struct ResponseWithAttachment {
+        Response response;
+        [[no_unique_address]] Attachment attachment;
+    };
+    struct NoAttachment {};
+
     void Read() { 
         using namespace std::literals;
-        // Очищаем запрос от прежнего значения (метод Read может быть вызван несколько раз)
-        request_ = {};
+        reading_ = true;
+        // Парсер одноразовый, поэтому создаётся для каждого запроса, но хранится в сессии, а не в куче
+        parser_.emplace();
         stream_.expires_after(30s);
-        // Считываем request_ из stream_, используя buffer_ для хранения считанных данных
-        http::async_read(stream_, buffer_, request_,
+        // Считываем запрос из stream_, используя buffer_ для хранения считанных данных
+        http::async_read(stream_, buffer_, *parser_,
                          // По окончании операции будет вызван метод OnRead
-                         beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis()));
+                         net::bind_allocator(GetHandlerAllocator(), 
+                                             beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis())));
     }
 
     void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
         using namespace std::literals;
+        reading_ = false;
         if (ec == http::error::end_of_stream) {
-            // Нормальная ситуация - клиент закрыл соединение
-            return Close();
+            // Нормальная ситуация - клиент закрыл соединение. Закрываем его после отправки оставшихся ответов
+            reading_finished_ = true;
+            return CloseIfDone();
         }
         if (ec) {
+            reading_finished_ = true;
             return ReportError(ec, "read"sv);
         }
         
+        const auto& request = parser_->get();
         json_logger::LogData("request received"sv,
                              boost::json::object{{"ip", stream_.socket().remote_endpoint().address().to_string()},
-                                                 {"URI", request_.target()}, 
-                                                 {"method", boost::to_upper_copy<std::string>(request_.method_string())}});
+                                                 {"URI", RedactTarget(request.target())},
+                                                 {"method", boost::to_upper_copy<std::string>(request.method_string())}});
+
+        const auto index = requests_read_++;
+        if (websocket::is_upgrade(request)) {
+            // Соединение может перейти к WebSocket-сессии только после отправки всех предыдущих ответов.
+            // До ответа на этот запрос следующие запросы не читаются
+            upgrade_index_ = index;
+            upgrade_request_.emplace(parser_->release());
+            return HandleUpgradeIfReady();
+        }
+        if (!request.keep_alive()) {
+            // Соединение будет закрыто после ответа на этот запрос
+            reading_finished_ = true;
+        }
+        HandleRequest(parser_->release(), index);
+        ReadIfAllowed();
+    }
+
+    void ReadIfAllowed() {
+        if (reading_ || reading_finished_ || closed_ || requests_read_ - responses_written_ >= pending_responses_.size()) {
+            return;
+        }
+        if (upgrade_index_ && responses_written_ <= *upgrade_index_) {
+            return;
+        }
+        Read();
+    }
+
+    void HandleUpgradeIfReady() {
+        if (upgrade_request_ && responses_written_ == *upgrade_index_) {
+            auto request = std::move(*upgrade_request_);
+            upgrade_request_.reset();
+            HandleRequest(std::move(request), *upgrade_index_);
+        }
+    }
 
-        HandleRequest(std::move(request_));
+    void CloseIfDone() {
+        if (reading_finished_ && !closed_ && !writing_response_ && responses_written_ == requests_read_) {
+            Close();
+        }
     }
 
     void Close() {
+        closed_ = true;
         beast::error_code ec;
         stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
     }
 
-    // Обработку запроса делегируем подклассу
-    virtual void HandleRequest(HttpRequest&& request) = 0;
+    // Передаёт соединение WebSocket-сессии, HTTP-сессия после этого завершается
+    void UpgradeToWebSocket(HttpRequest&& request, WebSocketSession::OnOpen on_open) {
+        std::make_shared<WebSocketSession>(std::move(stream_))->Run(std::move(request), std::move(on_open));
+    }
+
+    // Обработку запроса делегируем подклассу. Ответ на запрос передаётся в Write с тем же номером index
+    virtual void HandleRequest(HttpRequest&& request, std::uint64_t index) = 0;
 
     virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
 
 protected:
-    template <typename Body, typename Fields>
-    void Write(http::response<Body, Fields>&& response) {
-        // Запись выполняется асинхронно, поэтому response перемещаем в область кучи
-        auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
-
-        auto self = GetSharedThis();
-        http::async_write(stream_, *safe_response,
-                          [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
-                              self->OnWrite(safe_response->need_eof(), ec, bytes_written);
-                          });
+    // Можно вызывать из любого потока. attachment разрушается после отправки ответа (или закрытия соединения)
+    template <typename Body, typename Fields, typename Attachment = NoAttachment>
+    void Write(http::response<Body, Fields>&& response, std::uint64_t index, Attachment&& attachment = {}) {
+        using StoredResponse = ResponseWithAttachment<http::response<Body, Fields>, std::decay_t<Attachment>>;
+        // Запись выполняется асинхронно, поэтому ответ хранится в сессии до её окончания.
+        // Память под ответ и обработчики берётся из блоков соединения, а не из кучи
+        auto safe_response = std::allocate_shared<StoredResponse>(GetHandlerAllocator(), 
+                                                                  StoredResponse{std::move(response), std::move(attachment)});
+        net::dispatch(stream_.get_executor(),
+                      net::bind_allocator(GetHandlerAllocator(), 
+                                          [self = GetSharedThis(), index, safe_response = std::move(safe_response)]() mutable {
+                                              self->OnResponseReady(index, {std::move(safe_response), 
+                                                                            &SessionBase::AsyncWriteResponse<StoredResponse>});
+                                          }));
     }
 
 private:
+    HandlerAllocator<char> GetHandlerAllocator() noexcept {
+        return HandlerAllocator<char>(handler_memory_);
+    }
+
+    void OnResponseReady(std::uint64_t index, PendingResponse&& response) {
+        if (closed_) {
+            return;
+        }
+        pending_responses_[index % pending_responses_.size()] = std::move(response);
+        WriteNext();
+    }
+
+    // Отправляет следующий по порядку ответ, если он уже готов
+    void WriteNext() {
+        if (writing_response_ || closed_) {
+            return;
+        }
+        auto& next = pending_responses_[responses_written_ % pending_responses_.size()];
+        if (!next.response) {
+            return;
+        }
+        writing_response_ = std::move(next.response);
+        next.async_write(*this, writing_response_.get());
+    }
+
+    template <typename StoredResponse>
+    static void AsyncWriteResponse(SessionBase& session, void* response) {
+        auto& response_to_write = static_cast<StoredResponse*>(response)->response;
+        const bool close = response_to_write.need_eof();
+        http::async_write(session.stream_, response_to_write,
+                          net::bind_allocator(session.GetHandlerAllocator(), 
+                                              [self = session.GetSharedThis(), close](beast::error_code ec, std::size_t bytes_written) {
+                                                  self->OnWrite(close, ec, bytes_written);
+                                              }));
+    }
+
     void OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+        writing_response_.reset();
+        ++responses_written_;
         if (ec) {
+            closed_ = true;
             return ReportError(ec, "write"sv);
         }
         if (close) {
             // Семантика ответа требует закрыть соединение
             return Close();
         }
-        // Считываем следующий запрос
-        Read();
+        HandleUpgradeIfReady();
+        WriteNext();
+        // Считываем следующий запрос, если очередь ответов освободилась
+        ReadIfAllowed();
+        CloseIfDone();
     }
 
 private:
-    // tcp_stream содержит внутри себя сокет и добавляет поддержку таймаутов
-    beast::tcp_stream stream_;
+    // Поток содержит внутри себя сокет и добавляет поддержку таймаутов
+    ConnectionStream stream_;
     beast::flat_buffer buffer_;
-    HttpRequest request_;
+    // Должна быть объявлена до объектов, память которых из неё выделяется
+    HandlerMemory handler_memory_;
+    std::optional<http::request_parser<http::string_body>> parser_;
+    // Ответы, ожидающие отправки, по номеру запроса по модулю глубины конвейера
+    std::vector<PendingResponse> pending_responses_;
+    // Отправляемый ответ (тип зависит от тела ответа)
+    std::shared_ptr<void> writing_response_;
+    std::uint64_t requests_read_ = 0;
+    std::uint64_t responses_written_ = 0;
+    // Запрос на переход к WebSocket, ожидающий отправки предыдущих ответов
+    std::optional<HttpRequest> upgrade_request_;
+    std::optional<std::uint64_t> upgrade_index_;
+    bool reading_ = false;
+    // Новых запросов не будет: клиент закрыл соединение, произошла ошибка или запрос требует закрыть соединение
+    bool reading_finished_ = false;
+    bool closed_ = false;
+    // Запросы соединения, обработка которых отложена обработчиком запросов
+    std::shared_ptr<DeferredRequests> deferred_requests_ = std::make_shared<DeferredRequests>();
+    OpenConnection open_connection_;
+};
+
+// Передаётся обработчику запросов для отправки ответа произвольного типа на запрос с номером request_index
+class ResponseSender {
+public:
+    ResponseSender(std::shared_ptr<SessionBase> session, std::uint64_t request_index)
+        : session_(std::move(session))
+        , request_index_(request_index) {
+    }
+
+    template <typename Response>
+    void operator()(Response&& response) const {
+        session_->Write(std::move(response), request_index_);
+    }
+
+    // attachment (например, место в бюджете запросов) живёт, пока отправляется ответ
+    template <typename Response, typename Attachment>
+    void operator()(Response&& response, Attachment&& attachment) const {
+        session_->Write(std::move(response), request_index_, std::move(attachment));
+    }
+
+    // Отложенные запросы соединения: следующие запросы соединения не должны их обгонять
+    DeferredRequests& GetDeferredRequests() const noexcept {
+        return *session_->deferred_requests_;
+    }
+
+protected:
+    std::shared_ptr<SessionBase> session_;
+    std::uint64_t request_index_;
+};
+
+/*
+ * Передаётся обработчику запросов вместо функции отправки ответа, если клиент запросил WebSocket.
+ * Обработчик либо принимает соединение (Accept), либо отклоняет его, отправив обычный HTTP-ответ
+ */
+class WebSocketUpgrade : public ResponseSender {
+public:
+    using HttpRequest = http::request<http::string_body>;
+
+    using ResponseSender::ResponseSender;
+
+    void Accept(HttpRequest&& request, WebSocketSession::OnOpen on_open) {
+        session_->UpgradeToWebSocket(std::move(request), std::move(on_open));
+    }
 };
 
 template <typename RequestHandler>
 class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
 public:
     template <typename Handler>
-    Session(tcp::socket&& socket, Handler&& request_handler)
-        : SessionBase(std::move(socket))
+    Session(ConnectionSocket&& socket, std::size_t pipeline_depth, Handler&& request_handler)
+        : SessionBase(std::move(socket), pipeline_depth)
         , request_handler_(std::forward<Handler>(request_handler)) {
     }
 
@@ -125,13 +417,15 @@ private:
         return this->shared_from_this();
     }  
     
-    void HandleRequest(HttpRequest&& request) override {
-        // Захватываем умный указатель на текущий объект Session в лямбде,
-        // чтобы продлить время жизни сессии до вызова лямбды.
-        // Используется generic-лямбда функция, способная принять response произвольного типа
-        request_handler_(std::move(request), [self = this->shared_from_this()](auto&& response) {
-            self->Write(std::move(response));
-        });
+    void HandleRequest(HttpRequest&& request, std::uint64_t index) override {
+        if (websocket::is_upgrade(request)) {
+            request_handler_(std::move(request), WebSocketUpgrade{this->shared_from_this(), index});
+            return;
+        }
+
+        // ResponseSender хранит умный указатель на текущий объект Session,
+        // чтобы продлить время жизни сессии до отправки ответа
+        request_handler_(std::move(request), ResponseSender{this->shared_from_this(), index});
     }
 
 private:
@@ -142,10 +436,15 @@ template <typename RequestHandler>
 class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
 public:
     template <typename Handler>
-    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler)
+    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, const ServerOptions& options, Handler&& request_handler)
         : ioc_(ioc)
         // Обработчики асинхронных операций acceptor_ будут вызываться в своём strand
         , acceptor_(net::make_strand(ioc))
+        , pipeline_depth_(options.pipeline_depth)
+        , max_connections_(options.max_connections)
+        , reject_response_(std::make_shared<const std::string>(
+              "HTTP/1.1 503 Service Unavailable\r\nRetry-After: "s + std::to_string(options.retry_after.count()) 
+              + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"s))
         , request_handler_(std::forward<Handler>(request_handler)) {
         // Открываем acceptor, используя протокол (IPv4 или IPv6), указанный в endpoint
         acceptor_.open(endpoint.protocol());
@@ -155,6 +454,10 @@ public:
         // Однако это может помешать повторно открыть сокет в полузакрытом состоянии.
         // Флаг reuse_address разрешает открыть сокет, когда он "наполовину закрыт"
         acceptor_.set_option(net::socket_base::reuse_address(true));
+        if (options.reuse_port) {
+            // Несколько acceptor-ов слушают один порт, ядро распределяет между ними новые соединения
+            acceptor_.set_option(ReusePort(true));
+        }
         // Привязываем acceptor к адресу и порту endpoint
         acceptor_.bind(endpoint);
         // Переводим acceptor в состояние, в котором он способен принимать новые соединения
@@ -184,37 +487,44 @@ private:
     }
 
     // Метод socket::async_accept создаст сокет и передаст его передан в OnAccept
-    void OnAccept(beast::error_code ec, tcp::socket socket) {
+    void OnAccept(beast::error_code ec, ConnectionSocket socket) {
         using namespace std::literals;
 
         if (ec) {
             return ReportError(ec, "accept"sv);
         }
 
-        // Асинхронно обрабатываем сессию
-        AsyncRunSession(std::move(socket));
+        if (max_connections_ != 0 && OpenConnection::GetCount() >= static_cast<std::int64_t>(max_connections_)) {
+            RejectConnection(std::move(socket), reject_response_);
+        } else {
+            // Асинхронно обрабатываем сессию
+            AsyncRunSession(std::move(socket));
+        }
 
         // Принимаем новое соединение
         DoAccept();
     }
 
-    void AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+    void AsyncRunSession(ConnectionSocket&& socket) {
+        std::make_shared<Session<RequestHandler>>(std::move(socket), pipeline_depth_, request_handler_)->Run();
     }
 
 private:
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
+    std::size_t pipeline_depth_;
+    std::size_t max_connections_;
+    std::shared_ptr<const std::string> reject_response_;
     RequestHandler request_handler_;
 };
 
 template <typename RequestHandler>
-void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler, const ServerOptions& options = {}) {
     // При помощи decay_t исключим ссылки из типа RequestHandler,
     // чтобы Listener хранил RequestHandler по значению
     using MyListener = Listener<std::decay_t<RequestHandler>>;
 
-    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+    std::make_shared<MyListener>(ioc, endpoint, options, std::forward<RequestHandler>(handler))->Run();
 }
 
 }  // namespace http_server
@@ -4,6 +4,10 @@
 
 #include "json_logger.h"
 
+#include <unistd.h>
+
+#include <memory>
+
 namespace json_logger {
 
 using namespace std::literals;
@@ -15,6 +19,13 @@ namespace expr = boost::log::expressions;
 
 BOOST_LOG_ATTRIBUTE_KEYWORD(timestamp, "TimeStamp", boost::posix_time::ptime)
 
+namespace {
+
+std::unique_ptr<AsyncLogSink> async_sink_owner;
+std::atomic<AsyncLogSink*> async_sink{nullptr};
+
+}  // namespace
+
 void LogFormatter(logging::record_view const& rec, logging::formatting_ostream& strm) {
     // Момент времени
     auto ts = *rec[timestamp];
@@ -45,7 +56,42 @@ void InitLogger() {
     ); 
 }
 
+void InitAsyncLogger(AsyncLogSink::Options options) {
+    std::cout.flush();
+    async_sink_owner = std::make_unique<AsyncLogSink>(STDOUT_FILENO, options);
+    async_sink.store(async_sink_owner.get(), std::memory_order_release);
+}
+
+void ShutdownAsyncLogger() {
+    if (!async_sink_owner) {
+        return;
+    }
+    async_sink.store(nullptr, std::memory_order_release);
+    async_sink_owner->Stop();
+    if (const auto dropped_count = async_sink_owner->GetDroppedCount(); dropped_count > 0) {
+        LogData("log records dropped"sv, json::object{{"count", dropped_count}});
+    }
+    async_sink_owner.reset();
+}
+
+std::uint64_t GetDroppedRecordCount() noexcept {
+    auto* sink = async_sink.load(std::memory_order_acquire);
+    return sink ? sink->GetDroppedCount() : 0;
+}
+
 void LogData(std::string_view message, const boost::json::value& additional_data_value) {
+    if (auto* sink = async_sink.load(std::memory_order_acquire)) {
+        // Порядок полей как у LogFormatter
+        auto message_object = json::object{
+            {"timestamp"s, to_iso_extended_string(boost::posix_time::microsec_clock::local_time())},
+            {"data"s, additional_data_value},
+            {"message"s, message}
+        };
+        auto record = json::serialize(message_object);
+        record.push_back('\n');
+        sink->Push(std::move(record));
+        return;
+    }
     BOOST_LOG_TRIVIAL(info) << boost::log::add_value(additional_data, additional_data_value) << message;
 }
 
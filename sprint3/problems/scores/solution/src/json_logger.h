@@ -8,6 +8,8 @@
 #include <boost/log/utility/setup/console.hpp>
 #include <boost/log/utility/manipulators/add_value.hpp>
 
+#include "async_log_sink.h"
+
 BOOST_LOG_ATTRIBUTE_KEYWORD(additional_data, "AdditionalData", boost::json::value)
 
 namespace json_logger {
@@ -16,6 +18,17 @@ void LogFormatter(boost::log::record_view const& rec, boost::log::formatting_ost
 
 void InitLogger();
 
+/*
+ * Переключает лог на асинхронный вывод в stdout: запись форматируется в вызывающем потоке,
+ * а выводится фоновым потоком. ShutdownAsyncLogger выводит оставшиеся записи и возвращает синхронный режим.
+ * Вызывать, когда другие потоки не пишут в лог
+ */
+void InitAsyncLogger(AsyncLogSink::Options options);
+void ShutdownAsyncLogger();
+
+// Количество записей, отброшенных асинхронным логом
+std::uint64_t GetDroppedRecordCount() noexcept;
+
 void LogData(std::string_view message, const boost::json::value& additional_data_value);
 
 }  // namespace json_logger
\ No newline at end of file
@@ -32,6 +32,7 @@ model::Map MapFromJson(const json::value& value, Game& game, ExtraData &extra_da
     for (const auto& item : obj.at("roads"s).as_array()) {
         map.AddRoad(RoadFromJson(item.as_object()));
     }
+    map.BuildRoadCorridors();
     for (const auto& item : obj.at("buildings"s).as_array()) {
         map.AddBuilding(BuildingFromJson(item.as_object()));
     }
@@ -64,12 +65,23 @@ std::tuple<model::Game, ExtraData> LoadGame(const std::filesystem::path& json_pa
     extra_data.base_interval = duration_cast<milliseconds>(duration_cast<seconds>(duration<double>(base_interval)));
     extra_data.probability = loot_generator_config.at("probability"sv).as_double();
 
+    // Отрицательное или нулевое значение при приведении к size_t дало бы огромный лимит или совпало бы с "без ограничения"
+    size_t max_session_players = Game::UNLIMITED_SESSION_PLAYERS;
+    if (game_data.contains("maxSessionPlayers"sv)) {
+        const auto value = game_data.at("maxSessionPlayers"sv).as_int64();
+        if (value < 1) {
+            throw std::invalid_argument("maxSessionPlayers must be positive");
+        }
+        max_session_players = static_cast<size_t>(value);
+    }
+
     Game game(game_data.contains("defaultDogSpeed"sv) 
               ? game_data.at("defaultDogSpeed"sv).as_double() 
               : Game::DEFAULT_SPEED,
               game_data.contains("defaultBagCapacity"sv) 
               ? game_data.at("defaultBagCapacity"sv).as_int64() 
-              : Game::DEFAULT_BAG_CAPACITY);
+              : Game::DEFAULT_BAG_CAPACITY,
+              max_session_players);
     for (const auto& map_item : game_data.at("maps"s).as_array()) {
         game.AddMap(MapFromJson(map_item.as_object(), game, extra_data));
     }
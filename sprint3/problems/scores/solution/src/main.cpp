@@ -5,8 +5,16 @@
 #include <boost/core/detail/string_view.hpp>
 #include <boost/program_options.hpp>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "admission.h"
 #include "application.h"
 #include "json_parser.h"
 #include "json_logger.h"
@@ -34,6 +42,32 @@ void RunWorkers(unsigned n, const Fn& fn) {
     fn();
 }
 
+void PinCurrentThreadToCore(unsigned core) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core, &cpu_set);
+    // Ядро может быть недоступно процессу (например, в контейнере), тогда поток остаётся непривязанным
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+    (void)core;
+#endif
+}
+
+// Запускает каждый io_context шардов в своём потоке, привязанном к ядру, а игровой io_context - в текущем потоке
+void RunShards(const std::vector<std::unique_ptr<net::io_context>>& shards, net::io_context& game_ioc) {
+    const unsigned core_count = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::jthread> workers;
+    workers.reserve(shards.size());
+    for (unsigned i = 0; i < shards.size(); ++i) {
+        workers.emplace_back([&shard = *shards[i], core = i % core_count] {
+            PinCurrentThreadToCore(core);
+            shard.run();
+        });
+    }
+    game_ioc.run();
+}
+
 }  // namespace
 
 struct Args {
@@ -41,6 +75,15 @@ struct Args {
     std::string config_file;
     std::string www_root;
     bool randomize_spawn_points;
+    bool parallel_tick;
+    bool async_log;
+    json_logger::OverflowPolicy log_overflow_policy;
+    std::size_t log_queue_size;
+    std::size_t tick_profile_depth;
+    std::size_t pipeline_depth;
+    unsigned io_shards;
+    std::size_t max_connections;
+    admission::Limits limits;
 }; 
 
 [[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
@@ -49,12 +92,38 @@ struct Args {
     po::options_description desc{"Allowed options"s};
 
     Args args;
+    std::string log_overflow_policy;
+    int max_api_queue_age = 0;
+    int retry_after = 0;
     desc.add_options()
         ("help,h", "produce help message")
         ("tick-period,t", po::value(&args.tick_period)->value_name("milliseconds"), "set tick period")
         ("config-file,c", po::value(&args.config_file)->value_name("file"), "set config file path")
         ("www-root,w", po::value(&args.www_root)->value_name("dir"), "set static files root")
-        ("randomize-spawn-points", "spawn dogs at random positions ");
+        ("randomize-spawn-points", "spawn dogs at random positions ")
+        ("parallel-tick", "process game sessions in parallel on tick")
+        ("async-log", "write log records from a background thread")
+        ("log-overflow", po::value(&log_overflow_policy)->value_name("drop|block")->default_value("drop"s), 
+            "what to do with async log records when the queue is full")
+        ("log-queue-size", po::value(&args.log_queue_size)->value_name("records")->default_value(8192), 
+            "set async log queue size")
+        ("tick-profile-depth", po::value(&args.tick_profile_depth)->value_name("ticks")->default_value(128), 
+            "set number of recent ticks kept by the tick profiler (0 disables profiling)")
+        ("pipeline-depth", po::value(&args.pipeline_depth)->value_name("requests")->default_value(1), 
+            "set number of pipelined requests per connection awaiting response")
+        ("io-shards", po::value(&args.io_shards)->value_name("count")->default_value(0), 
+            "serve connections on this number of single-threaded io_contexts pinned to cores "
+            "(0 - one io_context shared by all threads)")
+        ("max-connections", po::value(&args.max_connections)->value_name("count")->default_value(0), 
+            "reject connections over this number with 503 (0 - no limit)")
+        ("max-api-queue", po::value(&args.limits.max_api_queue_depth)->value_name("requests")->default_value(0), 
+            "reject API requests with 503 when this number of requests waits for the API strand (0 - no limit)")
+        ("max-api-queue-age", po::value(&max_api_queue_age)->value_name("milliseconds")->default_value(0), 
+            "reject API requests with 503 that waited for the API strand longer (0 - no limit)")
+        ("max-static-requests", po::value(&args.limits.max_static_requests)->value_name("requests")->default_value(0), 
+            "reject static file requests with 503 over this number of concurrent requests (0 - no limit)")
+        ("retry-after", po::value(&retry_after)->value_name("seconds")->default_value(1), 
+            "set Retry-After header value of rejected requests");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -73,47 +142,84 @@ struct Args {
     if (!vm.contains("tick-period"s)) {
         args.tick_period = -1;
     }
+    if (args.pipeline_depth == 0) {
+        throw std::runtime_error("Pipeline depth must be positive"s);
+    }
+    if (max_api_queue_age < 0 || retry_after < 0) {
+        throw std::runtime_error("Admission control timeouts must not be negative"s);
+    }
+    args.limits.max_api_queue_age = std::chrono::milliseconds(max_api_queue_age);
+    args.limits.retry_after = std::chrono::seconds(retry_after);
     args.randomize_spawn_points = vm.contains("randomize-spawn-points"s);
+    args.parallel_tick = vm.contains("parallel-tick"s);
+    args.async_log = vm.contains("async-log"s);
+    if (log_overflow_policy == "drop"sv) {
+        args.log_overflow_policy = json_logger::OverflowPolicy::Drop;
+    } else if (log_overflow_policy == "block"sv) {
+        args.log_overflow_policy = json_logger::OverflowPolicy::Block;
+    } else {
+        throw std::runtime_error("Invalid log overflow policy"s);
+    }
 
     return args;
 } 
 
 int main(int argc, const char* argv[]) {
     json_logger::InitLogger();
+    int exit_code = EXIT_SUCCESS;
     try {
         if (auto args = ParseCommandLine(argc, argv)) {
+            if (args->async_log) {
+                json_logger::InitAsyncLogger({args->log_queue_size, args->log_overflow_policy});
+            }
+
             std::filesystem::path config_file = args->config_file;
             std::string www_root = args->www_root;
 
+            const unsigned num_threads = std::thread::hardware_concurrency();
+
             // 1. Создаем приложение, управляющее игрой и действиями в игре
             auto [game, extra_data] = json_parser::LoadGame<game_scenarios::ExtraData>(config_file);
             game_scenarios::Application app(std::move(game),
                                             std::move(extra_data),
                                             args->randomize_spawn_points,
-                                            args->tick_period >= 0);
+                                            args->tick_period >= 0,
+                                            args->parallel_tick ? num_threads : 1u,
+                                            args->tick_profile_depth);
 
-            // 2. Инициализируем io_context
-            const unsigned num_threads = std::thread::hardware_concurrency();
-            net::io_context ioc(num_threads);
+            // 2. Инициализируем io_context.
+            // В режиме с шардами он выполняет только работу игры (api_strand, тики, сигналы) в одном потоке,
+            // а соединения обслуживаются однопоточными io_context шардов и не переходят между ними.
+            // Работа с игрой передаётся из шардов в api_strand через очередь игрового io_context
+            // Шарды объявлены раньше, чтобы ожидающие в ioc обработчики разрушались, пока сокеты шардов ещё живы
+            std::vector<std::unique_ptr<net::io_context>> shards;
+            for (unsigned i = 0; i < args->io_shards; ++i) {
+                shards.push_back(std::make_unique<net::io_context>(1));
+            }
+            net::io_context ioc(args->io_shards ? 1u : num_threads);
 
             // 3. Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
             // Подписываемся на сигналы и при их получении завершаем работу сервера
             net::signal_set signals(ioc, SIGINT, SIGTERM);
-            signals.async_wait([&ioc](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+            signals.async_wait([&ioc, &shards](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
                 if (!ec) {
                     ioc.stop();
+                    for (auto& shard : shards) {
+                        shard->stop();
+                    }
                 }
             });
 
             // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры
             auto api_strand = net::make_strand(ioc);
-            auto handler = std::make_shared<http_handler::RequestHandler>(app, www_root, api_strand);
+            auto handler = std::make_shared<http_handler::RequestHandler>(app, www_root, api_strand, args->limits);
 
-            // 5. Настраиваем вызов метода RequestHandler::Tick
+            // 5. Настраиваем вызов метода RequestHandler::Tick и рассылку состояния игры подписчикам WebSocket
             auto ticker = std::make_shared<http_handler::Ticker>(api_strand, std::chrono::milliseconds(args->tick_period),
-                [&app](std::chrono::milliseconds delta) { 
+                [&app, handler](std::chrono::milliseconds delta) { 
                     if (app.GetAutoTick()) {
                         app.Tick(delta);
+                        handler->PushGameState();
                     }                    
                 }
             );
@@ -122,23 +228,43 @@ int main(int argc, const char* argv[]) {
             // 6. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
             const auto address = net::ip::make_address("0.0.0.0");
             constexpr unsigned short port = 8080;
-            http_server::ServeHttp(ioc, {address, port}, [handler](auto&& req, auto&& send) {
+            auto serve = [handler](auto&& req, auto&& send) {
                 (*handler)(std::forward<decltype(req)>(req), 
                         std::forward<decltype(send)>(send));
-            });        
+            };
+            http_server::ServerOptions server_options{
+                .pipeline_depth = args->pipeline_depth,
+                .max_connections = args->max_connections,
+                .retry_after = args->limits.retry_after
+            };
+            if (shards.empty()) {
+                http_server::ServeHttp(ioc, {address, port}, serve, server_options);
+            } else {
+                // У каждого шарда свой acceptor на том же порту, ядро распределяет соединения между ними
+                server_options.reuse_port = true;
+                for (auto& shard : shards) {
+                    http_server::ServeHttp(*shard, {address, port}, serve, server_options);
+                }
+            }
 
             // Эта надпись сообщает тестам о том, что сервер запущен и готов обрабатывать запросы
             json_logger::LogData("server started"sv, boost::json::object{{"port", port}, {"address", address.to_string()}});
 
             // 7. Запускаем обработку асинхронных операций
-            RunWorkers(std::max(1u, num_threads), [&ioc] {
-                ioc.run();
-            });
+            if (shards.empty()) {
+                RunWorkers(std::max(1u, num_threads), [&ioc] {
+                    ioc.run();
+                });
+            } else {
+                RunShards(shards, ioc);
+            }
 
             json_logger::LogData("server exited"sv, boost::json::object{{"code", 0}});
         }
     } catch (const std::exception& ex) {
         json_logger::LogData("server exited"sv, boost::json::object{{"code", EXIT_FAILURE}, {"exception", ex.what()}});
-        return EXIT_FAILURE;
+        exit_code = EXIT_FAILURE;
     }
+    json_logger::ShutdownAsyncLogger();
+    return exit_code;
 }
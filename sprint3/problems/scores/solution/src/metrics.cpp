@@ -0,0 +1,217 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <sstream>
+
+namespace metrics {
+
+using namespace std::literals;
+
+namespace {
+
+// Границы корзин гистограмм Prometheus, секунды
+constexpr std::array<double, 16> PROMETHEUS_BUCKETS{
+    0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+    0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0
+};
+constexpr std::array<double, 4> QUANTILES{0.5, 0.9, 0.99, 0.999};
+
+double ToSeconds(std::uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1e9;
+}
+
+// Гистограмма в формате Prometheus и квантили в отдельной метрике-датчике (<name>_quantile)
+void WriteHistogram(std::ostream& out, std::string_view name, const std::string& labels,
+                    const LatencyHistogram::Snapshot& snapshot) {
+    const auto label_prefix = labels.empty() ? "{"s : "{"s + labels + ","s;
+    for (double bound : PROMETHEUS_BUCKETS) {
+        const auto count = snapshot.GetCountNotAbove(static_cast<std::uint64_t>(std::llround(bound * 1e9)));
+        out << name << "_bucket" << label_prefix << "le=\"" << bound << "\"} " << count << '\n';
+    }
+    out << name << "_bucket" << label_prefix << "le=\"+Inf\"} " << snapshot.count << '\n';
+    const auto plain_labels = labels.empty() ? ""s : "{"s + labels + "}"s;
+    out << name << "_sum" << plain_labels << ' ' << ToSeconds(snapshot.sum) << '\n';
+    out << name << "_count" << plain_labels << ' ' << snapshot.count << '\n';
+}
+
+void WriteQuantiles(std::ostream& out, std::string_view name, const std::string& labels,
+                    const LatencyHistogram::Snapshot& snapshot) {
+    const auto label_prefix = labels.empty() ? "{"s : "{"s + labels + ","s;
+    for (double quantile : QUANTILES) {
+        out << name << "_quantile" << label_prefix << "quantile=\"" << quantile << "\"} "
+            << ToSeconds(snapshot.GetValueAtQuantile(quantile)) << '\n';
+    }
+}
+
+}  // namespace
+
+std::uint64_t LatencyHistogram::Snapshot::GetValueAtQuantile(double quantile) const noexcept {
+    if (count == 0) {
+        return 0;
+    }
+    const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(quantile * static_cast<double>(count))));
+    std::uint64_t accumulated = 0;
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+        accumulated += buckets[i];
+        if (accumulated >= rank) {
+            return GetBucketUpperBound(i);
+        }
+    }
+    return GetBucketUpperBound(BUCKET_COUNT - 1);
+}
+
+std::uint64_t LatencyHistogram::Snapshot::GetCountNotAbove(std::uint64_t value) const noexcept {
+    std::uint64_t result = 0;
+    for (std::size_t i = 0; i < BUCKET_COUNT && GetBucketUpperBound(i) <= value; ++i) {
+        result += buckets[i];
+    }
+    return result;
+}
+
+void LatencyHistogram::AddTo(Snapshot& snapshot) const noexcept {
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+        snapshot.buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+    }
+    snapshot.count += count_.load(std::memory_order_relaxed);
+    snapshot.sum += sum_.load(std::memory_order_relaxed);
+}
+
+std::size_t LatencyHistogram::GetBucketIndex(std::uint64_t value) noexcept {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<std::size_t>(value);
+    }
+    // Старший бит задаёт степень двойки, следующие SUB_BUCKET_BITS бит - часть внутри неё
+    const auto msb = static_cast<std::size_t>(std::bit_width(value)) - 1;
+    const auto shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT + static_cast<std::size_t>((value >> shift) & (SUB_BUCKET_COUNT - 1));
+}
+
+std::uint64_t LatencyHistogram::GetBucketUpperBound(std::size_t index) noexcept {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const auto shift = index / SUB_BUCKET_COUNT - 1;
+    const auto sub_bucket = index % SUB_BUCKET_COUNT;
+    // Для последней корзины сдвиг переполняется и даёт максимальное значение
+    return ((SUB_BUCKET_COUNT + sub_bucket + 1) << shift) - 1;
+}
+
+RequestMetrics::RequestMetrics(std::vector<std::string> endpoint_names)
+    : endpoint_names_{std::move(endpoint_names)}
+    , shards_{std::make_unique<Shard[]>(SHARD_COUNT)} {
+    for (std::size_t i = 0; i < SHARD_COUNT; ++i) {
+        shards_[i].durations = std::make_unique<std::atomic<LatencyHistogram*>[]>(endpoint_names_.size() * STATUS_SLOT_COUNT);
+        shards_[i].request_bytes = std::make_unique<std::atomic<std::uint64_t>[]>(endpoint_names_.size());
+        shards_[i].response_bytes = std::make_unique<std::atomic<std::uint64_t>[]>(endpoint_names_.size());
+    }
+}
+
+RequestMetrics::~RequestMetrics() {
+    for (std::size_t i = 0; i < SHARD_COUNT; ++i) {
+        for (std::size_t j = 0; j < endpoint_names_.size() * STATUS_SLOT_COUNT; ++j) {
+            delete shards_[i].durations[j].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void RequestMetrics::RecordRequest(std::size_t endpoint, unsigned status, Clock::duration duration,
+                                   std::uint64_t request_body_size, std::uint64_t response_body_size) {
+    Shard& shard = GetThreadShard();
+    auto& slot = shard.durations[endpoint * STATUS_SLOT_COUNT + GetStatusSlot(status)];
+    auto* histogram = slot.load(std::memory_order_acquire);
+    if (!histogram) {
+        // Шард могут использовать несколько потоков, поэтому гистограмму может успеть создать другой поток
+        auto created = std::make_unique<LatencyHistogram>();
+        if (slot.compare_exchange_strong(histogram, created.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            histogram = created.release();
+        }
+    }
+    histogram->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    shard.request_bytes[endpoint].fetch_add(request_body_size, std::memory_order_relaxed);
+    shard.response_bytes[endpoint].fetch_add(response_body_size, std::memory_order_relaxed);
+}
+
+void RequestMetrics::RecordStrandDelay(Clock::duration delay) noexcept {
+    GetThreadShard().strand_delay.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count());
+}
+
+std::string RequestMetrics::FormatPrometheus(const Gauges& gauges, const Counters& counters) const {
+    std::ostringstream out;
+
+    out << "# HELP game_server_request_duration_seconds Request handling time by endpoint and status code\n"
+        << "# TYPE game_server_request_duration_seconds histogram\n";
+    std::vector<std::pair<std::string, LatencyHistogram::Snapshot>> durations;
+    for (std::size_t endpoint = 0; endpoint < endpoint_names_.size(); ++endpoint) {
+        for (std::size_t status_slot = 0; status_slot < STATUS_SLOT_COUNT; ++status_slot) {
+            LatencyHistogram::Snapshot snapshot;
+            for (std::size_t i = 0; i < SHARD_COUNT; ++i) {
+                if (const auto* histogram = shards_[i].durations[endpoint * STATUS_SLOT_COUNT + status_slot].load(std::memory_order_acquire)) {
+                    histogram->AddTo(snapshot);
+                }
+            }
+            if (snapshot.count == 0) {
+                continue;
+            }
+            const auto code = status_slot < STATUS_CODES.size() ? std::to_string(STATUS_CODES[status_slot]) : "other"s;
+            auto labels = "endpoint=\""s + endpoint_names_[endpoint] + "\",code=\""s + code + "\""s;
+            WriteHistogram(out, "game_server_request_duration_seconds"sv, labels, snapshot);
+            durations.emplace_back(std::move(labels), snapshot);
+        }
+    }
+
+    out << "# HELP game_server_request_duration_seconds_quantile Request handling time quantiles\n"
+        << "# TYPE game_server_request_duration_seconds_quantile gauge\n";
+    for (const auto& [labels, snapshot] : durations) {
+        WriteQuantiles(out, "game_server_request_duration_seconds"sv, labels, snapshot);
+    }
+
+    auto write_bytes = [&](std::string_view name, std::string_view help,
+                           std::unique_ptr<std::atomic<std::uint64_t>[]> Shard::*counters) {
+        out << "# HELP " << name << ' ' << help << '\n'
+            << "# TYPE " << name << " counter\n";
+        for (std::size_t endpoint = 0; endpoint < endpoint_names_.size(); ++endpoint) {
+            std::uint64_t total = 0;
+            for (std::size_t i = 0; i < SHARD_COUNT; ++i) {
+                total += (shards_[i].*counters)[endpoint].load(std::memory_order_relaxed);
+            }
+            out << name << "{endpoint=\"" << endpoint_names_[endpoint] << "\"} " << total << '\n';
+        }
+    };
+    write_bytes("game_server_request_body_bytes_total"sv, "Received request body bytes"sv, &Shard::request_bytes);
+    write_bytes("game_server_response_body_bytes_total"sv, "Sent response body bytes"sv, &Shard::response_bytes);
+
+    LatencyHistogram::Snapshot strand_delay;
+    for (std::size_t i = 0; i < SHARD_COUNT; ++i) {
+        shards_[i].strand_delay.AddTo(strand_delay);
+    }
+    out << "# HELP game_server_strand_delay_seconds Time API requests wait for the API strand\n"
+        << "# TYPE game_server_strand_delay_seconds histogram\n";
+    WriteHistogram(out, "game_server_strand_delay_seconds"sv, ""s, strand_delay);
+    out << "# TYPE game_server_strand_delay_seconds_quantile gauge\n";
+    WriteQuantiles(out, "game_server_strand_delay_seconds"sv, ""s, strand_delay);
+
+    for (const auto& [name, value] : gauges) {
+        out << "# TYPE " << name << " gauge\n"
+            << name << ' ' << value << '\n';
+    }
+    for (const auto& [name, value] : counters) {
+        out << "# TYPE " << name << "_total counter\n"
+            << name << "_total " << value << '\n';
+    }
+    return out.str();
+}
+
+std::size_t RequestMetrics::GetStatusSlot(unsigned status) noexcept {
+    const auto it = std::find(STATUS_CODES.begin(), STATUS_CODES.end(), status);
+    return static_cast<std::size_t>(it - STATUS_CODES.begin());
+}
+
+RequestMetrics::Shard& RequestMetrics::GetThreadShard() noexcept {
+    static std::atomic<std::size_t> next_shard{0};
+    thread_local const std::size_t shard_index = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    return shards_[shard_index];
+}
+
+}  // namespace metrics
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace metrics {
+
+/*
+ * Гистограмма длительностей в наносекундах в стиле HDR Histogram: корзины идут по степеням двойки,
+ * каждая степень делится на SUB_BUCKET_COUNT равных частей (относительная погрешность не больше 1/8).
+ * Запись - несколько атомарных сложений без блокировок
+ */
+class LatencyHistogram {
+public:
+    static constexpr std::size_t SUB_BUCKET_BITS = 3;
+    static constexpr std::size_t SUB_BUCKET_COUNT = std::size_t{1} << SUB_BUCKET_BITS;
+    static constexpr std::size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    struct Snapshot {
+        std::array<std::uint64_t, BUCKET_COUNT> buckets{};
+        std::uint64_t count = 0;
+        std::uint64_t sum = 0;
+
+        // Граница сверху для доли quantile записанных значений
+        std::uint64_t GetValueAtQuantile(double quantile) const noexcept;
+        // Количество значений, не превышающих value (с точностью до корзины)
+        std::uint64_t GetCountNotAbove(std::uint64_t value) const noexcept;
+    };
+
+    void Record(std::uint64_t value) noexcept {
+        buckets_[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // Добавляет значения гистограммы к snapshot. Значения, записываемые одновременно, могут учесться частично
+    void AddTo(Snapshot& snapshot) const noexcept;
+
+    static std::size_t GetBucketIndex(std::uint64_t value) noexcept;
+    // Наибольшее значение, попадающее в корзину
+    static std::uint64_t GetBucketUpperBound(std::size_t index) noexcept;
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets_{};
+    std::atomic<std::uint64_t> count_{0};
+    std::atomic<std::uint64_t> sum_{0};
+};
+
+/*
+ * Метрики обработки запросов: гистограммы длительности по конечной точке и коду ответа,
+ * объёмы тел запросов и ответов, задержка запросов в очереди strand-а.
+ * Каждый поток пишет в свой шард, поэтому потоки не соперничают за одни и те же счётчики.
+ * Методы можно вызывать из любых потоков
+ */
+class RequestMetrics {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Значения дополнительных метрик-датчиков для вывода: имя и значение
+    using Gauges = std::vector<std::pair<std::string_view, std::int64_t>>;
+    // Значения дополнительных монотонных счётчиков: имя без суффикса _total и значение
+    using Counters = std::vector<std::pair<std::string_view, std::uint64_t>>;
+
+    // Коды ответа, для которых ведутся отдельные гистограммы, остальные учитываются вместе
+    static constexpr std::array<unsigned, 12> STATUS_CODES{200, 204, 206, 304, 400, 401, 403, 404, 405, 413, 500, 503};
+    static constexpr std::size_t SHARD_COUNT = 8;
+
+    explicit RequestMetrics(std::vector<std::string> endpoint_names);
+    ~RequestMetrics();
+
+    RequestMetrics(const RequestMetrics&) = delete;
+    RequestMetrics& operator=(const RequestMetrics&) = delete;
+
+    void RecordRequest(std::size_t endpoint, unsigned status, Clock::duration duration,
+                       std::uint64_t request_body_size, std::uint64_t response_body_size);
+    void RecordStrandDelay(Clock::duration delay) noexcept;
+
+    // Метрики в текстовом формате Prometheus. Имена счётчиков counters выводятся с суффиксом _total
+    std::string FormatPrometheus(const Gauges& gauges, const Counters& counters = {}) const;
+
+private:
+    struct alignas(64) Shard {
+        // Гистограммы [конечная точка][код ответа] создаются при первой записи
+        std::unique_ptr<std::atomic<LatencyHistogram*>[]> durations;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> request_bytes;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> response_bytes;
+        LatencyHistogram strand_delay;
+    };
+
+    static constexpr std::size_t STATUS_SLOT_COUNT = STATUS_CODES.size() + 1;
+
+    static std::size_t GetStatusSlot(unsigned status) noexcept;
+    Shard& GetThreadShard() noexcept;
+
+private:
+    std::vector<std::string> endpoint_names_;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace metrics
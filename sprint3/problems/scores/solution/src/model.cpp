@@ -5,6 +5,165 @@
 namespace model {
 using namespace std::literals;
 
+namespace {
+
+struct DogNextState {
+    PointD position;
+    bool stopped;
+};
+
+// Положение собаки через time_delta секунд. Если собака упирается в границу дорог, она останавливается на ней
+DogNextState CalcDogNextState(const Map& map, PointD position, Dog::Speed speed, Direction direction, 
+                              DimensionD time_delta) {
+    if (speed.x == 0.0 && speed.y == 0.0) {
+        return {position, true};
+    }
+
+    const PointD next_pos{position.x + speed.x * time_delta, position.y + speed.y * time_delta};
+    const auto& roads = map.GetRoads();
+
+    // Есть ли дорога, которая содержит получившеюся позицию (проверяем только дороги рядом с позицией)
+    const auto& near_road_indices = map.GetRoadsNear(next_pos);
+    const bool on_road = std::any_of(near_road_indices.begin(), near_road_indices.end(), [&roads, &next_pos](size_t road_index) {
+        return roads[road_index].Contains(next_pos);
+    });
+    if (on_road) {
+        return {next_pos, false};
+    }
+
+    // Нет дороги, которая содержала бы вычисленную позицию: движемся до границы коридора дорог в зависимости от направления
+    PointD limited_pos = position;
+    const auto move_limit = map.GetMoveLimit(position, direction);
+    switch (direction) {
+        case Direction::NORTH:
+        case Direction::SOUTH:
+            limited_pos.y = move_limit;
+            break;
+        case Direction::WEST:
+        case Direction::EAST:
+            limited_pos.x = move_limit;
+            break;
+    }
+    return {limited_pos, true};
+}
+
+}  // namespace
+
+void RoadGrid::AddRoad(const Road& road, size_t road_index) {
+    const auto min_x = ToCell(std::min(road.GetStart().x, road.GetEnd().x) - Road::HALF_WIDTH);
+    const auto max_x = ToCell(std::max(road.GetStart().x, road.GetEnd().x) + Road::HALF_WIDTH);
+    const auto min_y = ToCell(std::min(road.GetStart().y, road.GetEnd().y) - Road::HALF_WIDTH);
+    const auto max_y = ToCell(std::max(road.GetStart().y, road.GetEnd().y) + Road::HALF_WIDTH);
+    for (auto cell_x = min_x; cell_x <= max_x; ++cell_x) {
+        for (auto cell_y = min_y; cell_y <= max_y; ++cell_y) {
+            cells_[MakeCellKey(cell_x, cell_y)].emplace_back(road_index);
+        }
+    }
+}
+
+const RoadGrid::RoadIndices& RoadGrid::GetRoadsNear(PointD point) const noexcept {
+    static const RoadIndices no_roads;
+    if (auto it = cells_.find(MakeCellKey(ToCell(point.x), ToCell(point.y))); it != cells_.end()) {
+        return it->second;
+    }
+    return no_roads;
+}
+
+void RoadCorridors::Build(const std::vector<Road>& roads) {
+    horizontal_.clear();
+    vertical_.clear();
+    for (const auto& road : roads) {
+        const auto start = road.GetStart();
+        const auto end = road.GetEnd();
+        if (road.IsHorizontal()) {
+            AddSegment(horizontal_, start.y, Segment{std::min(start.x, end.x), std::max(start.x, end.x)});
+        } else {
+            AddSegment(vertical_, start.x, Segment{std::min(start.y, end.y), std::max(start.y, end.y)});
+        }
+    }
+    MergeSegments(horizontal_);
+    MergeSegments(vertical_);
+}
+
+void RoadCorridors::AddSegment(Corridors& corridors, Coord line, Segment segment) {
+    auto it = std::lower_bound(corridors.begin(), corridors.end(), line, [](const Corridor& corridor, Coord line) {
+        return corridor.line < line;
+    });
+    if (it == corridors.end() || it->line != line) {
+        it = corridors.insert(it, Corridor{line, {}});
+    }
+    it->segments.emplace_back(segment);
+}
+
+void RoadCorridors::MergeSegments(Corridors& corridors) {
+    for (auto& corridor : corridors) {
+        auto& segments = corridor.segments;
+        std::sort(segments.begin(), segments.end(), [](const Segment& lhs, const Segment& rhs) {
+            return lhs.begin < rhs.begin;
+        });
+
+        // Объединяем отрезки, расширенные на ширину дороги, если они пересекаются или соприкасаются
+        std::vector<Segment> merged;
+        for (const auto& segment : segments) {
+            if (!merged.empty() 
+                && segment.begin - Road::HALF_WIDTH <= merged.back().end + Road::HALF_WIDTH) {
+                merged.back().end = std::max(merged.back().end, segment.end);
+            } else {
+                merged.emplace_back(segment);
+            }
+        }
+        segments = std::move(merged);
+    }
+}
+
+std::optional<std::pair<Coord, RoadCorridors::Segment>> RoadCorridors::FindSegment(const Corridors& corridors, 
+                                                                                   CoordD line_coord, 
+                                                                                   CoordD along_coord) noexcept {
+    auto corridor_it = std::lower_bound(corridors.begin(), corridors.end(), line_coord - Road::HALF_WIDTH, 
+                                        [](const Corridor& corridor, CoordD coord) {
+                                            return corridor.line < coord;
+                                        });
+    for (; corridor_it != corridors.end() && corridor_it->line <= line_coord + Road::HALF_WIDTH; ++corridor_it) {
+        const auto& segments = corridor_it->segments;
+        // Последний отрезок, начало которого не дальше точки
+        auto segment_it = std::upper_bound(segments.begin(), segments.end(), along_coord + Road::HALF_WIDTH, 
+                                           [](CoordD coord, const Segment& segment) {
+                                               return coord < segment.begin;
+                                           });
+        if (segment_it == segments.begin()) {
+            continue;
+        }
+        --segment_it;
+        if (along_coord <= segment_it->end + Road::HALF_WIDTH) {
+            return std::make_pair(corridor_it->line, *segment_it);
+        }
+    }
+    return std::nullopt;
+}
+
+CoordD RoadCorridors::GetMoveLimit(PointD position, Direction direction) const noexcept {
+    const bool vertical_move = (direction == Direction::NORTH || direction == Direction::SOUTH);
+    const bool forward_move = (direction == Direction::SOUTH || direction == Direction::EAST);
+    const CoordD along = vertical_move ? position.y : position.x;
+    const CoordD across = vertical_move ? position.x : position.y;
+
+    // Коридор вдоль направления движения: до его края
+    const auto& along_corridors = vertical_move ? vertical_ : horizontal_;
+    if (auto found = FindSegment(along_corridors, across, along)) {
+        const auto& segment = found->second;
+        return forward_move ? segment.end + Road::HALF_WIDTH : segment.begin - Road::HALF_WIDTH;
+    }
+
+    // Поперечная дорога: можно дойти только до ее края
+    const auto& cross_corridors = vertical_move ? horizontal_ : vertical_;
+    if (auto found = FindSegment(cross_corridors, along, across)) {
+        const auto line = found->first;
+        return forward_move ? line + Road::HALF_WIDTH : line - Road::HALF_WIDTH;
+    }
+
+    return along;
+}
+
 void Map::AddOffice(Office office) {
     if (warehouse_id_to_index_.contains(office.GetId())) {
         throw std::invalid_argument("Duplicate warehouse");
@@ -21,6 +180,41 @@ void Map::AddOffice(Office office) {
     }
 }
 
+GameSession::DogPaths GameSession::MoveDogs(DimensionD time_delta) {
+    const size_t dog_count = GetDogCount();
+    DogPaths paths{std::vector<CoordD>(dog_count), std::vector<CoordD>(dog_count), 
+                   std::vector<CoordD>(dog_count), std::vector<CoordD>(dog_count)};
+    for (size_t slot = 0; slot < dog_count; ++slot) {
+        const auto next_state = CalcDogNextState(*map_, dog_positions_[slot], dog_speeds_[slot], dog_directions_[slot], time_delta);
+        paths.start_xs[slot] = dog_positions_[slot].x;
+        paths.start_ys[slot] = dog_positions_[slot].y;
+        paths.end_xs[slot] = next_state.position.x;
+        paths.end_ys[slot] = next_state.position.y;
+        // Стоящая собака не меняется, движущаяся меняет положение или останавливается
+        if (dog_speeds_[slot].x != 0.0 || dog_speeds_[slot].y != 0.0) {
+            MarkDogChanged(slot);
+        }
+        dog_positions_[slot] = next_state.position;
+        if (next_state.stopped) {
+            dog_speeds_[slot] = Dog::Speed{0.0, 0.0};
+        }
+    }
+    return paths;
+}
+
+void GameSession::FinishTick() {
+    current_changes_.tick = ++tick_;
+    for (size_t slot : current_changes_.changed_dogs) {
+        dog_changed_[slot] = false;
+    }
+    recent_tick_changes_.push_back(std::make_shared<const TickChanges>(std::move(current_changes_)));
+    if (recent_tick_changes_.size() > MAX_RECENT_TICKS) {
+        recent_tick_changes_.pop_front();
+    }
+    current_changes_ = TickChanges{};
+    first_current_lost_object_id_ = next_lost_object_id_;
+}
+
 void Game::AddMap(Map map) {
     const size_t index = maps_.size();
     if (auto [it, inserted] = map_id_to_index_.emplace(map.GetId(), index); !inserted) {
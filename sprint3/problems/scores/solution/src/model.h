@@ -1,10 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <optional>
 #include <random>
+#include <span>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "tagged.h"
@@ -38,6 +44,20 @@ struct Offset {
     Dimension dx, dy;
 };
 
+class DirectionConvertException : public std::invalid_argument {
+public: 
+    using std::invalid_argument::invalid_argument;
+};
+
+enum class Direction {
+    NORTH,
+    SOUTH,
+    WEST,
+    EAST
+};
+std::string DirectionToString(Direction direction) noexcept;
+Direction DirectionFromString(const std::string& direction);
+
 class Road {
     struct HorizontalTag {
         explicit HorizontalTag() = default;
@@ -78,11 +98,85 @@ public:
         return end_;
     }
 
+    // Находится ли точка на дороге (с учетом ширины дороги)
+    bool Contains(PointD point) const noexcept {
+        return point.x >= std::min(start_.x, end_.x) - HALF_WIDTH
+               && point.x <= std::max(start_.x, end_.x) + HALF_WIDTH
+               && point.y >= std::min(start_.y, end_.y) - HALF_WIDTH
+               && point.y <= std::max(start_.y, end_.y) + HALF_WIDTH;
+    }
+
 private:
     Point start_;
     Point end_;
 };
 
+/*
+ * Пространственный индекс дорог: равномерная сетка ячеек.
+ * Каждая ячейка хранит индексы дорог (по возрастанию), прямоугольники которых
+ * (с учетом ширины дороги) пересекают ячейку.
+ */
+class RoadGrid {
+public:
+    using RoadIndices = std::vector<size_t>;
+
+    static constexpr DimensionD CELL_SIZE = 8.0;
+
+    void AddRoad(const Road& road, size_t road_index);
+
+    // Индексы дорог, которые могут содержать точку
+    const RoadIndices& GetRoadsNear(PointD point) const noexcept;
+
+private:
+    using CellKey = std::uint64_t;
+
+    static std::int32_t ToCell(CoordD coord) noexcept {
+        return static_cast<std::int32_t>(std::floor(coord / CELL_SIZE));
+    }
+    static CellKey MakeCellKey(std::int32_t cell_x, std::int32_t cell_y) noexcept {
+        return (static_cast<CellKey>(static_cast<std::uint32_t>(cell_x)) << 32) 
+               | static_cast<std::uint32_t>(cell_y);
+    }
+
+    std::unordered_map<CellKey, RoadIndices> cells_;
+};
+
+/*
+ * Коридоры дорог: горизонтальные и вертикальные дороги, лежащие на одной линии,
+ * объединены в отсортированные непересекающиеся отрезки (пересекающиеся и соприкасающиеся дороги сливаются).
+ * Позволяет за O(log n) найти координату, дальше которой нельзя продвинуться в заданном направлении.
+ */
+class RoadCorridors {
+public:
+    void Build(const std::vector<Road>& roads);
+
+    // Координата (вдоль направления движения), до которой можно дойти из точки position.
+    // Если точка не лежит ни на одной дороге, возвращается ее собственная координата.
+    CoordD GetMoveLimit(PointD position, Direction direction) const noexcept;
+
+private:
+    struct Segment {
+        Coord begin;
+        Coord end;
+    };
+    struct Corridor {
+        Coord line;
+        std::vector<Segment> segments;
+    };
+    // Коридоры отсортированы по line, отрезки коридора - по begin
+    using Corridors = std::vector<Corridor>;
+
+    static void AddSegment(Corridors& corridors, Coord line, Segment segment);
+    static void MergeSegments(Corridors& corridors);
+    // Линия коридора и его отрезок, содержащие точку (с учетом ширины дороги)
+    static std::optional<std::pair<Coord, Segment>> FindSegment(const Corridors& corridors, 
+                                                                CoordD line_coord, 
+                                                                CoordD along_coord) noexcept;
+
+    Corridors horizontal_; // line - y, отрезки по x
+    Corridors vertical_;   // line - x, отрезки по y
+};
+
 class Building {
 public:
     explicit Building(Rectangle bounds) noexcept
@@ -168,9 +262,25 @@ public:
     }
 
     void AddRoad(const Road& road) {
+        road_grid_.AddRoad(road, roads_.size());
         roads_.emplace_back(road);
     }
 
+    // Индексы дорог (по возрастанию), которые могут содержать точку
+    const RoadGrid::RoadIndices& GetRoadsNear(PointD point) const noexcept {
+        return road_grid_.GetRoadsNear(point);
+    }
+
+    // Строит коридоры дорог: вызывается после добавления всех дорог
+    void BuildRoadCorridors() {
+        road_corridors_.Build(roads_);
+    }
+
+    // Координата (вдоль направления движения), до которой можно дойти по дорогам из точки position
+    CoordD GetMoveLimit(PointD position, Direction direction) const noexcept {
+        return road_corridors_.GetMoveLimit(position, direction);
+    }
+
     void AddBuilding(const Building& building) {
         buildings_.emplace_back(building);
     }
@@ -183,6 +293,8 @@ private:
     Id id_;
     std::string name_;
     Roads roads_;
+    RoadGrid road_grid_;
+    RoadCorridors road_corridors_;
     Buildings buildings_;
 
     OfficeIdToIndex warehouse_id_to_index_;
@@ -191,20 +303,9 @@ private:
     size_t default_bag_capacity_;
 };
 
-class DirectionConvertException : public std::invalid_argument {
-public: 
-    using std::invalid_argument::invalid_argument;
-};
-
-enum class Direction {
-    NORTH,
-    SOUTH,
-    WEST,
-    EAST
-};
-std::string DirectionToString(Direction direction) noexcept;
-Direction DirectionFromString(const std::string& direction);
+class GameSession;
 
+// Собака - лёгкий дескриптор слота в игровой сессии, данные собаки хранит сама сессия
 class Dog {
 public:
     struct Speed {
@@ -215,85 +316,33 @@ public:
         size_t type;
     };
 
-private:
-    static constexpr PointD DEFAULT_POSITION = PointD{0.0, 0.0};
-    static constexpr Speed DEFAULT_SPEED = Speed{0.0, 0.0};
-    static constexpr size_t DEFAULT_BAG_CAPACITY = 3;
-
 public:
     using DogId = std::uint64_t;
 
-    Dog(const std::string& name, DogId id, PointD position = DEFAULT_POSITION, Speed speed = DEFAULT_SPEED, size_t bag_capacity = DEFAULT_BAG_CAPACITY) 
-        : name_(name)
-        , id_(id)
-        , position_(position)
-        , speed_(speed)
-        , bag_{bag_capacity, std::nullopt} {
+    Dog(GameSession* session, size_t slot) 
+        : session_(session)
+        , slot_(slot) {
     }
 
 public:
-    DogId GetId() const noexcept {
-        return id_;
-    }
-    PointD GetPosition() const noexcept {
-        return position_;
-    }
-    void SetPosition(PointD position) {
-        position_ = position;
-    }
-    std::vector<BagItem> GetBagItems() const noexcept {
-        std::vector<BagItem> items;
-        items.reserve(bag_.size());
-        for (const auto& item : bag_) {
-            if (item) {
-                items.emplace_back(*item);
-            }
-        }
-        return items;
-    }
-    bool AddItemInBag(BagItem item) {
-        auto empty_place_it = std::find(bag_.begin(), bag_.end(), std::nullopt);
-        if (empty_place_it == bag_.end()) {
-            return false;
-        }
-        *(*empty_place_it) = item;
-        return true;
-    }
-    size_t ClearBag() {
-        size_t item_count = bag_.size() - std::count(bag_.begin(), bag_.end(), std::nullopt);
-        bag_ = std::vector<std::optional<BagItem>>{bag_.size(), std::nullopt};
-        return item_count;
-    }
-    Speed GetSpeed() const noexcept {
-        return speed_;
-    }
-    void SetSpeed(Speed speed) {
-        speed_ = speed;
-    }
-    Direction GetDirection() const noexcept {
-        return direction_;
-    }
-    void SetDirection(Direction direction) {
-        direction_ = direction;
-    }
-    const std::string& GetName() const noexcept {
-        return name_;
-    }
+    DogId GetId() const noexcept;
+    PointD GetPosition() const noexcept;
+    void SetPosition(PointD position);
+    std::vector<BagItem> GetBagItems() const noexcept;
+    bool AddItemInBag(BagItem item);
+    size_t ClearBag();
+    Speed GetSpeed() const noexcept;
+    void SetSpeed(Speed speed);
+    Direction GetDirection() const noexcept;
+    void SetDirection(Direction direction);
+    const std::string& GetName() const noexcept;
 
 private:
-    std::string name_;
-    DogId id_;
-    Direction direction_ = Direction::NORTH;
-    PointD position_{0.0, 0.0};
-    Speed speed_{0.0, 0.0};
-    std::vector<std::optional<BagItem>> bag_;
+    GameSession* session_;
+    size_t slot_;
 };
 
 class GameSession {
-private:
-    using Dogs = std::vector<std::unique_ptr<Dog>>;
-    using DogIdToDog = std::unordered_map<std::uint64_t, Dog*>;
-
 public:
     explicit GameSession(const Map* map) : 
         map_(map) 
@@ -303,39 +352,86 @@ public:
     GameSession& operator=(const GameSession&) = delete;
 
 public:
-    Dog* CreateDog(const std::string& name, bool randomize_spawn_point = false) {
-        auto dog = dogs_.emplace_back(std::make_unique<Dog>(name, 
-                                                            dogs_.size(), 
-                                                            GenerateRoadPosition(randomize_spawn_point),
-                                                            Dog::Speed{0.0, 0.0},
-                                                            map_->GetDefaultBagCapacity())).get();
-        dog_id_to_dog_[dog->GetId()] = dog;
-        return dog;
-    }
-
-    std::vector<Dog*> GetDogs() {
-        std::vector<Dog*> dogs;
-        dogs.reserve(dogs_.size());
-        for (const auto& dog : dogs_) {
-            dogs.emplace_back(dog.get());
+    Dog CreateDog(const std::string& name, bool randomize_spawn_point = false) {
+        const size_t slot = dog_positions_.size();
+        dog_positions_.emplace_back(GenerateRoadPosition(randomize_spawn_point));
+        dog_speeds_.emplace_back(Dog::Speed{0.0, 0.0});
+        dog_directions_.emplace_back(Direction::NORTH);
+        dog_names_.emplace_back(name);
+        dog_bags_.resize(dog_bags_.size() + map_->GetDefaultBagCapacity(), std::nullopt);
+        dog_changed_.push_back(false);
+        MarkDogChanged(slot);
+        return Dog{this, slot};
+    }
+
+    std::vector<Dog> GetDogs() {
+        std::vector<Dog> dogs;
+        dogs.reserve(GetDogCount());
+        for (size_t slot = 0; slot < GetDogCount(); ++slot) {
+            dogs.emplace_back(this, slot);
         }
         return dogs;
     }
 
+    size_t GetDogCount() const noexcept {
+        return dog_positions_.size();
+    }
+
     const Map* GetMap() const {
         return map_;
     }
 
+public:
+    // Данные собак по слотам: часто используемые при движении данные лежат в отдельных непрерывных массивах.
+    // Изменяются только через Dog и MoveDogs, которые отмечают изменившихся собак в изменениях тика
+    const std::vector<PointD>& GetDogPositions() const noexcept {
+        return dog_positions_;
+    }
+    const std::vector<Dog::Speed>& GetDogSpeeds() const noexcept {
+        return dog_speeds_;
+    }
+    const std::vector<Direction>& GetDogDirections() const noexcept {
+        return dog_directions_;
+    }
+    const std::string& GetDogName(size_t slot) const {
+        return dog_names_[slot];
+    }
+
+    // Пути собак за время тика по слотам: начальные и конечные координаты
+    struct DogPaths {
+        std::vector<CoordD> start_xs, start_ys, end_xs, end_ys;
+    };
+
+    // Перемещает собак на time_delta секунд одним линейным проходом по массивам сессии.
+    // Собака, упёршаяся в границу дорог, останавливается на ней
+    DogPaths MoveDogs(DimensionD time_delta);
+
+    // Сумки всех собак лежат в одном массиве: у каждой собаки по bag_capacity мест подряд
+    std::span<const std::optional<Dog::BagItem>> GetDogBag(size_t slot) const noexcept {
+        const size_t bag_capacity = map_->GetDefaultBagCapacity();
+        return std::span{dog_bags_}.subspan(slot * bag_capacity, bag_capacity);
+    }
+
 public:
 struct LostObject {
+    using Id = std::uint64_t;
+
+    Id id = 0;
     size_t type = 0;
     PointD position{0.0, 0.0};
 };
 
+// Потерянные предметы лежат в массиве без дыр, порядок предметов при удалении может меняться.
+// Идентификатор предмета не меняется всё время, пока предмет находится на карте.
 const std::vector<LostObject>& GetLostObjects() const noexcept {
     return lost_objects_;
 }
 
+const LostObject* FindLostObject(LostObject::Id id) const {
+    auto it = lost_object_id_to_index_.find(id);
+    return (it != lost_object_id_to_index_.end() ? &lost_objects_[it->second] : nullptr);
+}
+
 void GenerateLostObjects(unsigned lost_object_count, size_t lost_object_types) {
     if (lost_object_types == 0) {
         return;
@@ -346,15 +442,81 @@ void GenerateLostObjects(unsigned lost_object_count, size_t lost_object_types) {
     std::uniform_int_distribution<size_t> unif(0, lost_object_types - 1);
 
     for (unsigned i = 0; i < lost_object_count; ++i) {
-        lost_objects_.push_back(LostObject{ unif(rand_engine), GenerateRoadPosition(true) });
+        lost_object_id_to_index_[next_lost_object_id_] = lost_objects_.size();
+        current_changes_.added_lost_objects.push_back(next_lost_object_id_);
+        lost_objects_.push_back(LostObject{ next_lost_object_id_++, unif(rand_engine), GenerateRoadPosition(true) });
     }
 }
 
-void RemoveLostObject(size_t lost_object_index) {
-    lost_objects_.erase(lost_objects_.begin() + lost_object_index);
+// Удаляет предмет за O(1): на его место переносится последний предмет массива
+bool RemoveLostObject(LostObject::Id id) {
+    auto it = lost_object_id_to_index_.find(id);
+    if (it == lost_object_id_to_index_.end()) {
+        return false;
+    }
+
+    const size_t index = it->second;
+    lost_object_id_to_index_.erase(it);
+    if (index + 1 != lost_objects_.size()) {
+        lost_objects_[index] = lost_objects_.back();
+        lost_object_id_to_index_[lost_objects_[index].id] = index;
+    }
+    lost_objects_.pop_back();
+
+    // Предмет, появившийся в текущем тике, читатели состояния ещё не видели
+    if (id >= first_current_lost_object_id_) {
+        std::erase(current_changes_.added_lost_objects, id);
+    } else {
+        current_changes_.removed_lost_objects.push_back(id);
+    }
+    return true;
 }
 
+public:
+    // Изменения сессии за один тик: собаки, у которых изменились положение, скорость, направление или сумка
+    // (очки игрока меняются только вместе с сумкой), а также появившиеся и исчезнувшие предметы
+    struct TickChanges {
+        std::uint64_t tick = 0;
+        std::vector<size_t> changed_dogs;
+        std::vector<LostObject::Id> added_lost_objects;
+        std::vector<LostObject::Id> removed_lost_objects;
+    };
+    using RecentTickChanges = std::deque<std::shared_ptr<const TickChanges>>;
+
+    // Количество последних тиков, изменения которых хранит сессия
+    static constexpr size_t MAX_RECENT_TICKS = 64;
+
+    // Номер последнего завершённого тика сессии (0 - тиков ещё не было)
+    std::uint64_t GetTick() const noexcept {
+        return tick_;
+    }
+
+    // Изменения последних завершённых тиков (от старых к новым). Завершённые изменения не меняются,
+    // поэтому их можно передавать в другие потоки
+    const RecentTickChanges& GetRecentTickChanges() const noexcept {
+        return recent_tick_changes_;
+    }
+
+    // Завершает тик: всё, что изменилось после завершения предыдущего тика (в том числе действия игроков
+    // между тиками), становится изменениями этого тика
+    void FinishTick();
+
 private:
+    // Dog изменяет данные собаки напрямую и отмечает собаку в изменениях тика
+    friend class Dog;
+
+    std::span<std::optional<Dog::BagItem>> GetMutableDogBag(size_t slot) noexcept {
+        const size_t bag_capacity = map_->GetDefaultBagCapacity();
+        return std::span{dog_bags_}.subspan(slot * bag_capacity, bag_capacity);
+    }
+
+    void MarkDogChanged(size_t slot) {
+        if (!dog_changed_[slot]) {
+            dog_changed_[slot] = true;
+            current_changes_.changed_dogs.push_back(slot);
+        }
+    }
+
     PointD GenerateRoadPosition(bool randomize = false) const noexcept {
         if (!randomize) {
             return PointD{CoordD(map_->GetRoads().at(0).GetStart().x), 
@@ -385,20 +547,108 @@ private:
     }
 
 private:
-    Dogs dogs_;
-    DogIdToDog dog_id_to_dog_;
     const Map* map_;
+
+    // Данные собак, индекс в массивах - слот собаки
+    std::vector<PointD> dog_positions_;
+    std::vector<Dog::Speed> dog_speeds_;
+    std::vector<Direction> dog_directions_;
+    std::vector<std::string> dog_names_;
+    std::vector<std::optional<Dog::BagItem>> dog_bags_;
+
     std::vector<LostObject> lost_objects_;
+    std::unordered_map<LostObject::Id, size_t> lost_object_id_to_index_;
+    LostObject::Id next_lost_object_id_ = 0;
+
+    // Изменения текущего (незавершённого) тика. dog_changed_[slot] - есть ли собака в current_changes_
+    TickChanges current_changes_;
+    std::vector<bool> dog_changed_;
+    // Предметы с идентификаторами не меньше этого появились в текущем тике
+    LostObject::Id first_current_lost_object_id_ = 0;
+    std::uint64_t tick_ = 0;
+    RecentTickChanges recent_tick_changes_;
 };
 
+// Идентификатор собаки совпадает с её слотом в сессии
+inline Dog::DogId Dog::GetId() const noexcept {
+    return slot_;
+}
+inline PointD Dog::GetPosition() const noexcept {
+    return session_->dog_positions_[slot_];
+}
+inline void Dog::SetPosition(PointD position) {
+    auto& current = session_->dog_positions_[slot_];
+    if (current.x != position.x || current.y != position.y) {
+        current = position;
+        session_->MarkDogChanged(slot_);
+    }
+}
+inline std::vector<Dog::BagItem> Dog::GetBagItems() const noexcept {
+    const auto bag = session_->GetDogBag(slot_);
+    std::vector<BagItem> items;
+    items.reserve(bag.size());
+    for (const auto& item : bag) {
+        if (item) {
+            items.emplace_back(*item);
+        }
+    }
+    return items;
+}
+inline bool Dog::AddItemInBag(BagItem item) {
+    const auto bag = session_->GetMutableDogBag(slot_);
+    auto empty_place_it = std::find(bag.begin(), bag.end(), std::nullopt);
+    if (empty_place_it == bag.end()) {
+        return false;
+    }
+    *empty_place_it = item;
+    session_->MarkDogChanged(slot_);
+    return true;
+}
+inline size_t Dog::ClearBag() {
+    const auto bag = session_->GetMutableDogBag(slot_);
+    size_t item_count = bag.size() - std::count(bag.begin(), bag.end(), std::nullopt);
+    if (item_count != 0) {
+        std::fill(bag.begin(), bag.end(), std::nullopt);
+        session_->MarkDogChanged(slot_);
+    }
+    return item_count;
+}
+inline Dog::Speed Dog::GetSpeed() const noexcept {
+    return session_->dog_speeds_[slot_];
+}
+inline void Dog::SetSpeed(Speed speed) {
+    auto& current = session_->dog_speeds_[slot_];
+    if (current.x != speed.x || current.y != speed.y) {
+        current = speed;
+        session_->MarkDogChanged(slot_);
+    }
+}
+inline Direction Dog::GetDirection() const noexcept {
+    return session_->dog_directions_[slot_];
+}
+inline void Dog::SetDirection(Direction direction) {
+    auto& current = session_->dog_directions_[slot_];
+    if (current != direction) {
+        current = direction;
+        session_->MarkDogChanged(slot_);
+    }
+}
+inline const std::string& Dog::GetName() const noexcept {
+    return session_->GetDogName(slot_);
+}
+
 class Game {
 public:
     static constexpr DimensionD DEFAULT_SPEED = 1.0;
     static constexpr size_t DEFAULT_BAG_CAPACITY = 3;
+    static constexpr size_t UNLIMITED_SESSION_PLAYERS = 0;
 
-    Game(DimensionD map_default_speed = DEFAULT_SPEED, size_t map_default_bag_capacity = DEFAULT_BAG_CAPACITY)
+    // max_session_players - максимальное количество игроков в одной сессии карты
+    Game(DimensionD map_default_speed = DEFAULT_SPEED, size_t map_default_bag_capacity = DEFAULT_BAG_CAPACITY,
+         size_t max_session_players = UNLIMITED_SESSION_PLAYERS)
          : map_default_speed_{map_default_speed}
          , map_default_bag_capacity_{map_default_bag_capacity}
+         , max_session_players_{max_session_players}
     {}
 
 public:
@@ -425,17 +675,45 @@ public:
         return map_default_bag_capacity_;
     }
 
+    size_t GetMaxSessionPlayers() const noexcept {
+        return max_session_players_;
+    }
+
+public:
+    using Sessions = std::vector<std::unique_ptr<GameSession>>;
+    using MapSessions = std::vector<GameSession*>;
+
     GameSession* CreateSession(const Map* map) {
-        return sessions_.emplace_back(std::make_unique<GameSession>(map)).get();
+        auto session = sessions_.emplace_back(std::make_unique<GameSession>(map)).get();
+        map_id_to_sessions_[map->GetId()].push_back(session);
+        return session;
+    }
+
+    // Возвращает сессию карты, в которую можно добавить игрока.
+    // Игроки не покидают сессии, поэтому свободные места могут быть только в последней сессии карты.
+    GameSession* GetSessionToJoin(const Map* map) {
+        const auto& map_sessions = GetMapSessions(map->GetId());
+        if (map_sessions.empty() 
+            || (max_session_players_ != UNLIMITED_SESSION_PLAYERS && map_sessions.back()->GetDogCount() >= max_session_players_)) {
+            return CreateSession(map);
+        }
+        return map_sessions.back();
     }
-    GameSession* FindSession(const Map* map) const {
-        auto it = std::find_if(sessions_.begin(), sessions_.end(), [map](const auto& session){ return session->GetMap() == map; });
-        return (it != sessions_.end() ? it->get() : nullptr);
+
+    const MapSessions& GetMapSessions(const Map::Id& id) const {
+        static const MapSessions no_sessions;
+        auto it = map_id_to_sessions_.find(id);
+        return (it != map_id_to_sessions_.end() ? it->second : no_sessions);
+    }
+
+    const Sessions& GetSessions() const noexcept {
+        return sessions_;
     }
 
 private:
     DimensionD map_default_speed_;
     size_t map_default_bag_capacity_;
+    size_t max_session_players_;
 
 private:
     using MapIdHasher = util::TaggedHasher<Map::Id>;
@@ -445,9 +723,10 @@ private:
     MapIdToIndex map_id_to_index_;
 
 private:
-    using Sessions = std::vector<std::unique_ptr<GameSession>>;
+    using MapIdToSessions = std::unordered_map<Map::Id, MapSessions, MapIdHasher>;
 
     Sessions sessions_;
+    MapIdToSessions map_id_to_sessions_;
 };
 
 }  // namespace model
@@ -1,46 +1,144 @@
 #pragma once
 
 #include "model.h"
+#include "token.h"
+#include "token_index.h"
 
-#include <iomanip>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <optional>
-#include <random>
-#include <unordered_set>
-#include <sstream>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace players {
 using namespace model;
 
-class Player {
-public:
-    struct State {
-        model::PointD position;
-        bool stopped;
+// Неизменяемый снимок состояния игровой сессии
+struct SessionSnapshot {
+    struct PlayerState {
+        Dog::DogId id;
+        std::string name;
+        PointD position;
+        Dog::Speed speed;
+        Direction direction;
+        std::vector<Dog::BagItem> bag;
+        size_t score;
     };
-    
+
+    // Номер последнего завершённого тика сессии. Снимок, опубликованный между тиками (при добавлении игрока),
+    // имеет номер предыдущего тика, а его изменения попадают в изменения следующего тика
+    std::uint64_t tick = 0;
+    // Игроки в порядке добавления в сессию: индекс игрока совпадает со слотом его собаки
+    std::vector<PlayerState> players;
+    std::vector<GameSession::LostObject> lost_objects;
+    // Изменения последних тиков сессии (от старых к новым), последний элемент - изменения тика tick
+    std::vector<std::shared_ptr<const GameSession::TickChanges>> recent_changes;
+
+    // Можно ли получить состояние этого снимка, применив recent_changes к состоянию после тика since
+    bool HasChangesSince(std::uint64_t since) const noexcept {
+        return since == tick || (since < tick && !recent_changes.empty() && recent_changes.front()->tick <= since + 1);
+    }
+
+    // Изменения всех тиков после since, объединённые в одно. Тик since должен удовлетворять HasChangesSince
+    struct MergedChanges {
+        std::vector<bool> changed_players;
+        std::unordered_set<GameSession::LostObject::Id> added_lost_objects;
+        std::unordered_set<GameSession::LostObject::Id> removed_lost_objects;
+    };
+
+    MergedChanges MergeChangesSince(std::uint64_t since) const {
+        MergedChanges merged;
+        merged.changed_players.assign(players.size(), false);
+        for (const auto& changes : recent_changes) {
+            if (changes->tick <= since) {
+                continue;
+            }
+            for (size_t slot : changes->changed_dogs) {
+                merged.changed_players[slot] = true;
+            }
+            merged.added_lost_objects.insert(changes->added_lost_objects.begin(), changes->added_lost_objects.end());
+            for (auto lost_object_id : changes->removed_lost_objects) {
+                // Предмет, появившийся и исчезнувший после since, клиенту неизвестен
+                if (!merged.added_lost_objects.erase(lost_object_id)) {
+                    merged.removed_lost_objects.insert(lost_object_id);
+                }
+            }
+        }
+        return merged;
+    }
+
+    // Сериализованный снимок строится один раз (при первом запросе) и отдаётся всем читателям этой версии
+    template <typename Serializer>
+    std::shared_ptr<const std::string> GetSerialized(Serializer&& serializer) const {
+        std::call_once(serialized_once_, [&] {
+            serialized_ = std::make_shared<const std::string>(serializer(*this));
+        });
+        return serialized_;
+    }
+
+private:
+    mutable std::once_flag serialized_once_;
+    mutable std::shared_ptr<const std::string> serialized_;
+};
+
+// Последний опубликованный снимок сессии: публикуется в strand-е, читается из любых потоков
+class SessionSnapshotHolder {
 public:
-    Player(Dog* dog, GameSession* session) :
+    std::shared_ptr<const SessionSnapshot> Get() const noexcept {
+        return std::atomic_load_explicit(&snapshot_, std::memory_order_acquire);
+    }
+
+    void Publish(std::shared_ptr<const SessionSnapshot> snapshot) noexcept {
+        std::atomic_store_explicit(&snapshot_, std::move(snapshot), std::memory_order_release);
+    }
+
+private:
+    std::shared_ptr<const SessionSnapshot> snapshot_;
+};
+
+class Player {
+public:
+    Player(Dog dog, GameSession* session, const SessionSnapshotHolder* session_snapshot) :
         dog_(dog),
-        session_(session)
+        session_(session),
+        session_snapshot_(session_snapshot)
      {}
 
 public:
     Dog::DogId GetId() const {
-        return dog_->GetId();
+        return dog_.GetId();
     }
 
     GameSession* GetSession() const noexcept {
         return session_;
     }
 
+    // Можно вызывать из любого потока
+    std::shared_ptr<const SessionSnapshot> GetSessionSnapshot() const noexcept {
+        return session_snapshot_->Get();
+    }
+
+    const std::string& GetName() const noexcept {
+        return dog_.GetName();
+    }
+
     model::PointD GetPosition() const {
-        return dog_->GetPosition();
+        return dog_.GetPosition();
+    }
+
+    Dog::Speed GetSpeed() const noexcept {
+        return dog_.GetSpeed();
+    }
+
+    Direction GetDirection() const noexcept {
+        return dog_.GetDirection();
     }
 
     std::vector<Dog::BagItem> GetBagItems() const {
-        return dog_->GetBagItems();
+        return dog_.GetBagItems();
     }    
 
     void AddScore(size_t score) {
@@ -52,15 +150,15 @@ public:
     }
 
     size_t ClearBag() {
-        return dog_->ClearBag();
+        return dog_.ClearBag();
     }
 
     bool AddItemInBag(size_t item_id, size_t item_type) {
-        return dog_->AddItemInBag(Dog::BagItem{item_id, item_type});
+        return dog_.AddItemInBag(Dog::BagItem{item_id, item_type});
     }
 
     void SetSpeed(Dog::Speed speed) {
-        dog_->SetSpeed(speed);
+        dog_.SetSpeed(speed);
     }
 
     void ChangeDirection(Direction direction) {
@@ -73,105 +171,14 @@ public:
             case Direction::WEST: speed = Dog::Speed{-speed_value, 0.0}; break;
             case Direction::EAST: speed = Dog::Speed{speed_value, 0.0}; break;
         }
-        dog_->SetDirection(direction);
-        dog_->SetSpeed(speed);
-    }
-
-    void SetState(Player::State state) {
-        dog_->SetPosition(state.position);
-        if (state.stopped) {
-            dog_->SetSpeed(Dog::Speed{0.0, 0.0});
-        }
-    }
-    
-    Player::State GetNextState(std::chrono::milliseconds time_delta) {
-        auto speed = dog_->GetSpeed();
-        if (speed.x == 0.0 && speed.y == 0.0) {
-            return {dog_->GetPosition(), true};
-        }
-
-        auto time_delta_d = std::chrono::duration<DimensionD>(time_delta).count();
-        auto current_pos = dog_->GetPosition();
-        auto next_pos = PointD{current_pos.x + (speed.x * time_delta_d), 
-                               current_pos.y + (speed.y * time_delta_d)};
-        const auto& roads = session_->GetMap()->GetRoads();
-        
-        // Есть ли дорога, которая содержит получившеюся позицию
-        auto any_road_it = std::find_if(roads.begin(), roads.end(), [&next_pos](const Road& road){
-            PointD min_road_pos{std::min(road.GetStart().x, road.GetEnd().x) - Road::HALF_WIDTH, 
-                                std::min(road.GetStart().y, road.GetEnd().y) - Road::HALF_WIDTH};
-            PointD max_road_pos{std::max(road.GetStart().x, road.GetEnd().x) + Road::HALF_WIDTH, 
-                                std::max(road.GetStart().y, road.GetEnd().y) + Road::HALF_WIDTH};
-            return (next_pos.x >= min_road_pos.x && next_pos.x <= max_road_pos.x
-                    && next_pos.y >= min_road_pos.y && next_pos.y <= max_road_pos.y);
-        });
-        if (any_road_it != roads.end()) {
-            return {next_pos, false};
-        }
-
-        // Нет дороги, которая содержала бы вычисленную позицию: ищем границу какой-то дороги взависимости от направления
-        next_pos = current_pos;
-        std::unordered_set<size_t> viewed_road_indeces;
-        while (true) {
-            int64_t roadIndex = FindRoadIndex(next_pos, viewed_road_indeces);
-            if (roadIndex == -1) {
-                break;
-            }
-
-            const auto& road = roads.at(roadIndex);
-            switch (dog_->GetDirection())
-            {
-            case Direction::NORTH: {
-                next_pos.y = std::min(road.GetStart().y, road.GetEnd().y);
-                next_pos.y -= Road::HALF_WIDTH;
-                break;
-            }
-            case Direction::SOUTH: {
-                next_pos.y = std::max(road.GetStart().y, road.GetEnd().y);
-                next_pos.y += Road::HALF_WIDTH;
-                break;
-            }
-            case Direction::WEST: {
-                next_pos.x = std::min(road.GetStart().x, road.GetEnd().x);
-                next_pos.x -= Road::HALF_WIDTH;
-                break;
-            }
-            case Direction::EAST: {
-                next_pos.x = std::max(road.GetStart().x, road.GetEnd().x);
-                next_pos.x += Road::HALF_WIDTH;
-                break;
-            }
-            }
-        }
-        return {next_pos, true};
+        dog_.SetDirection(direction);
+        dog_.SetSpeed(speed);
     }
 
 private:
-    int64_t FindRoadIndex(PointD pos, std::unordered_set<size_t>& viewed_road_indeces) {
-        const auto& roads = session_->GetMap()->GetRoads();
-        for (size_t i = 0; i < roads.size(); ++i) {
-            if (viewed_road_indeces.count(i)) {
-                continue;
-            }
-
-            const auto& road = roads.at(i);
-            PointD min_road_pos{std::min(road.GetStart().x, road.GetEnd().x) - Road::HALF_WIDTH, 
-                                std::min(road.GetStart().y, road.GetEnd().y) - Road::HALF_WIDTH};
-            PointD max_road_pos{std::max(road.GetStart().x, road.GetEnd().x) + Road::HALF_WIDTH, 
-                                std::max(road.GetStart().y, road.GetEnd().y) + Road::HALF_WIDTH};
-            if (pos.x >= min_road_pos.x && pos.x <= max_road_pos.x
-                && pos.y >= min_road_pos.y && pos.y <= max_road_pos.y) {
-                viewed_road_indeces.insert(i);
-                return i;
-            }
-        }
-        
-        return -1;
-    }
-
-private:
-    Dog* dog_;
+    Dog dog_;
     GameSession* session_;
+    const SessionSnapshotHolder* session_snapshot_;
     size_t score_{0};
 };
 
@@ -186,73 +193,95 @@ public:
     Players& operator=(const Players&) = delete;
 
 public:
-    using Token = std::string;
+    using Token = players::Token;
 
     struct PlayerInfo {
         Player* player;
         Token token;
     };
 
+    // Игроки одной игровой сессии (в порядке добавления) и снимок её состояния
+    struct SessionPlayers {
+        std::vector<Player*> players;
+        SessionSnapshotHolder snapshot;
+    };
+    using SessionToPlayers = std::unordered_map<GameSession*, std::unique_ptr<SessionPlayers>>;
+
 public:
-    PlayerInfo Add(Dog* dog, GameSession* session) {
+    // Добавление игроков должно быть сериализовано вызывающей стороной.
+    // Игрок становится доступен по токену после публикации снимка с ним.
+    PlayerInfo Add(Dog dog, GameSession* session) {
+        auto& session_players = session_to_players_[session];
+        if (!session_players) {
+            session_players = std::make_unique<SessionPlayers>();
+        }
+
         PlayerInfo player_info{
-            players_.emplace_back(std::make_unique<Player>(dog, session)).get(),
-            Players::GeneratePlayerToken()
+            players_.emplace_back(std::make_unique<Player>(dog, session, &session_players->snapshot)).get(),
+            GenerateToken()
         };
-        player_by_token_[player_info.token] = player_info.player;
+        session_players->players.push_back(player_info.player);
+        PublishSessionSnapshot(session);
+
+        while (!player_by_token_.Insert(player_info.token, player_info.player)) {
+            player_info.token = GenerateToken();
+        }
         return player_info;
     }
 
-    Player* FindByDogIdAndMapId(uint64_t dog_id, Map::Id map_id) {
-        return nullptr;
+    const SessionToPlayers& GetSessions() const noexcept {
+        return session_to_players_;
+    }
+
+    const std::vector<Player*>& GetSessionPlayers(GameSession* session) const {
+        return session_to_players_.at(session)->players;
     }
 
-    Player* FindByToken(const Token& token) {
-        if (!player_by_token_.count(token)) {
-            return nullptr;
+    // Снимок строится из текущего состояния сессии за O(игроков + предметов), поэтому публикуется
+    // только в конце тика и при добавлении игрока, а не при каждом действии игрока
+    void PublishSessionSnapshot(GameSession* session) {
+        auto& session_players = *session_to_players_.at(session);
+
+        auto snapshot = std::make_shared<SessionSnapshot>();
+        snapshot->tick = session->GetTick();
+        snapshot->players.reserve(session_players.players.size());
+        for (const auto* player : session_players.players) {
+            snapshot->players.emplace_back(SessionSnapshot::PlayerState{
+                player->GetId(),
+                player->GetName(),
+                player->GetPosition(),
+                player->GetSpeed(),
+                player->GetDirection(),
+                player->GetBagItems(),
+                player->GetScore()
+            });
         }
-        return player_by_token_[token];
+        snapshot->lost_objects = session->GetLostObjects();
+        const auto& recent_tick_changes = session->GetRecentTickChanges();
+        snapshot->recent_changes.assign(recent_tick_changes.begin(), recent_tick_changes.end());
+
+        session_players.snapshot.Publish(std::move(snapshot));
     }
 
-    const PlayersContainer& GetPlayers() const {
-        return players_;
+    Player* FindByDogIdAndMapId(uint64_t dog_id, Map::Id map_id) {
+        return nullptr;
     }
 
-    Player::State CalcPlayerNextState(Player* player, std::chrono::milliseconds time_delta) {
-        return player->GetNextState(time_delta);
+    // Можно вызывать из любого потока, в том числе одновременно с Add
+    Player* FindByToken(const Token& token) const noexcept {
+        return player_by_token_.Find(token);
     }
 
-private:
-    Token GeneratePlayerToken() {
-        static constexpr auto num_size = sizeof(std::mt19937_64::result_type)*2UL;
-
-        static std::stringstream stream;
-        stream << std::setfill('0') << std::setw(num_size) << std::hex << generator1_()
-               << std::setfill('0') << std::setw(num_size) << std::hex << generator2_();
-        auto token = stream.str();
-        
-        stream.str(std::string());
-        stream.clear();
-
-        return token;
+    const PlayersContainer& GetPlayers() const {
+        return players_;
     }
 
 private:
-    using PlayerByToken = std::unordered_map<Token, Player*>;
+    using PlayerByToken = TokenIndex<Player>;
 
     PlayersContainer players_;
     PlayerByToken player_by_token_;
-
-private:
-    std::random_device random_device_;
-    std::mt19937_64 generator1_{[this] {
-        std::uniform_int_distribution<std::mt19937_64::result_type> dist;
-        return dist(random_device_);
-    }()};
-    std::mt19937_64 generator2_{[this] {
-        std::uniform_int_distribution<std::mt19937_64::result_type> dist;
-        return dist(random_device_);
-    }()};
+    SessionToPlayers session_to_players_;
 };
 
 }  // namespace players
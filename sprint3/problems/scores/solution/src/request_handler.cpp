@@ -35,24 +35,72 @@ std::string_view RequestHandler::ContentType::GetContentTypeByFileExtension(fs::
     return file_extension_to_content_type.at(file_extension);
 }
 
-// Возвращает true, если каталог p содержится внутри base_path.
-bool RequestHandler::IsSubPath(fs::path wc_path, fs::path wc_base) {
-    // Проверяем, что все компоненты base содержатся внутри path
-    for (auto b = wc_base.begin(), p = wc_path.begin(); b != wc_base.end(); ++b, ++p) {
-        if (p == wc_path.end() || *p != *b) {
-            return false;
+// Заголовок вида "Bearer <32 шестнадцатеричные цифры>", токен разбирается прямо из заголовка без копирования
+std::optional<players::Token> RequestHandler::TryExtractToken(std::string_view auth_header) {
+    static constexpr auto prefix = "Bearer"sv;
+    if (auth_header.size() != prefix.size() + 1 + players::Token::HEX_SIZE
+        || !auth_header.starts_with(prefix)
+        || " \t\n\v\f\r"sv.find(auth_header[prefix.size()]) == std::string_view::npos) {
+        return {};
+    }
+    return players::Token::FromString(auth_header.substr(prefix.size() + 1));
+}
+
+// Сравнение ETag для If-None-Match: слабое, заголовок может содержать список тегов или "*"
+bool RequestHandler::IsETagMatched(std::string_view if_none_match, std::string_view etag) {
+    auto trim = [](std::string_view str) {
+        const auto begin = str.find_first_not_of(" \t"sv);
+        if (begin == std::string_view::npos) {
+            return std::string_view{};
+        }
+        return str.substr(begin, str.find_last_not_of(" \t"sv) - begin + 1);
+    };
+    auto opaque_tag = [](std::string_view tag) {
+        return tag.starts_with("W/"sv) ? tag.substr(2) : tag;
+    };
+
+    if (trim(if_none_match) == "*"sv) {
+        return true;
+    }
+    while (!if_none_match.empty()) {
+        const auto comma_pos = if_none_match.find(',');
+        if (opaque_tag(trim(if_none_match.substr(0, comma_pos))) == opaque_tag(etag)) {
+            return true;
+        }
+        if (comma_pos == std::string_view::npos) {
+            break;
         }
+        if_none_match.remove_prefix(comma_pos + 1);
     }
-    return true;
+    return false;
 }
 
-std::optional<std::string> RequestHandler::TryExtractToken(std::string&& auth_header) {
-    static const auto token_regex = std::regex(R"(Bearer\s([0-9a-fA-F]{32}))");
-    std::smatch match_results;
-    if (!regex_match(auth_header, match_results, token_regex)) {
-        return {};
+// Допускает ли клиент ответ в gzip: "gzip" или "*" в Accept-Encoding без q=0
+bool RequestHandler::IsGzipAccepted(std::string_view accept_encoding) {
+    bool gzip_accepted = false;
+    while (!accept_encoding.empty()) {
+        const auto comma_pos = accept_encoding.find(',');
+        std::string_view coding = accept_encoding.substr(0, comma_pos);
+        accept_encoding = comma_pos == std::string_view::npos ? std::string_view{} : accept_encoding.substr(comma_pos + 1);
+
+        std::string params;
+        if (const auto semicolon_pos = coding.find(';'); semicolon_pos != std::string_view::npos) {
+            params = boost::algorithm::erase_all_copy(std::string(coding.substr(semicolon_pos + 1)), " "s);
+            coding = coding.substr(0, semicolon_pos);
+        }
+        const auto name = boost::algorithm::to_lower_copy(boost::algorithm::trim_copy(std::string(coding)));
+        if (name != "gzip"sv && name != "*"sv) {
+            continue;
+        }
+
+        const bool rejected = params.starts_with("q=0"sv) && params.find_first_not_of("0."sv, 2) == std::string::npos;
+        // Явное указание gzip важнее "*"
+        if (name == "gzip"sv) {
+            return !rejected;
+        }
+        gzip_accepted = !rejected;
     }
-    return boost::algorithm::to_lower_copy(match_results[1].str());
+    return gzip_accepted;
 }
 
 }  // namespace http_handler
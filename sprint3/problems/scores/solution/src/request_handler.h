@@ -4,14 +4,23 @@
 #include <boost/beast.hpp>
 #include <boost/json.hpp>
 #include <boost/url.hpp>
+#include <cassert>
+#include <charconv>
+#include <chrono>
 #include <filesystem>
 #include <iostream>
-#include <regex>
+#include <optional>
 #include <variant>
 
+#include "admission.h"
+#include "api_router.h"
 #include "application.h"
+#include "game_state_streams.h"
 #include "json_logger.h"
 #include "http_server.h"
+#include "metrics.h"
+#include "shared_string_body.h"
+#include "static_file_cache.h"
 
 namespace http_handler {
 namespace net = boost::asio;
@@ -26,17 +35,29 @@ using namespace game_scenarios;
 
 using StringResponse = http::response<http::string_body>;
 using FileResponse = http::response<http::file_body>;
-using RequestResponse = std::variant<StringResponse,FileResponse>;
+using SharedStringResponse = http::response<http_server::SharedStringBody>;
+using RequestResponse = std::variant<StringResponse,FileResponse,SharedStringResponse>;
 using ParseJSONParamsException = sys::system_error;
 
+// Измеряет время подготовки ответа: пишет его в лог и учитывает в метриках конечной точки endpoint
 class MakingResponseDurationLogger {
 public:
-    explicit MakingResponseDurationLogger(RequestResponse& response) :
-        response_(response)
+    MakingResponseDurationLogger(RequestResponse& response, 
+                                 metrics::RequestMetrics& metrics, 
+                                 std::size_t endpoint, 
+                                 std::uint64_t request_body_size) :
+        response_(response),
+        metrics_(metrics),
+        endpoint_(endpoint),
+        request_body_size_(request_body_size)
     {}
     ~MakingResponseDurationLogger() {
-        std::chrono::system_clock::time_point end_ts = std::chrono::system_clock::now();
-        LogMadeResponseDuration(std::chrono::duration_cast<std::chrono::milliseconds>(end_ts - start_ts_).count());
+        const auto duration = metrics::RequestMetrics::Clock::now() - start_ts_;
+        const auto [code, response_body_size] = std::visit([](const auto& response) {
+            return std::pair{response.result_int(), response.payload_size().value_or(0)};
+        }, response_);
+        metrics_.RecordRequest(endpoint_, code, duration, request_body_size_, response_body_size);
+        LogMadeResponseDuration(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
     }
 
 private:
@@ -54,6 +75,11 @@ private:
             try { 
                 content_type = get<FileResponse>(response_).at(http::field::content_type); 
             } catch (const std::out_of_range& e) {}
+        } else if (holds_alternative<SharedStringResponse>(response_)) {
+            code = get<SharedStringResponse>(response_).result_int();
+            try { 
+                content_type = get<SharedStringResponse>(response_).at(http::field::content_type); 
+            } catch (const std::out_of_range& e) {}
         }
         
         json_logger::LogData("response sent"sv,
@@ -63,8 +89,11 @@ private:
     }
 
 private:
-    std::chrono::system_clock::time_point start_ts_ = std::chrono::system_clock::now();
+    metrics::RequestMetrics::Clock::time_point start_ts_ = metrics::RequestMetrics::Clock::now();
     RequestResponse& response_;
+    metrics::RequestMetrics& metrics_;
+    std::size_t endpoint_;
+    std::uint64_t request_body_size_;
 };
 
 enum class RequestType {
@@ -98,14 +127,93 @@ enum class ApiRequestType {
     Tick  
 };
 
+enum class ApiRoute {
+    GameJoin,
+    Players,
+    GameState,
+    GameStream,
+    Action,
+    Tick,
+    Maps,
+    Map,
+    Metrics,
+    TickProfile
+};
+
+// Конечные точки в метриках: маршруты API (в порядке ApiRoute), статические файлы и прочие запросы
+inline constexpr std::array METRICS_ENDPOINTS{
+    "/api/v1/game/join"sv,
+    "/api/v1/game/players"sv,
+    "/api/v1/game/state"sv,
+    "/api/v1/game/stream"sv,
+    "/api/v1/game/player/action"sv,
+    "/api/v1/game/tick"sv,
+    "/api/v1/maps"sv,
+    "/api/v1/maps/{id}"sv,
+    "/api/v1/metrics"sv,
+    "/api/v1/admin/tick-profile"sv,
+    "static"sv,
+    "other"sv
+};
+inline constexpr std::size_t STATIC_DATA_ENDPOINT = METRICS_ENDPOINTS.size() - 2;
+inline constexpr std::size_t OTHER_ENDPOINT = METRICS_ENDPOINTS.size() - 1;
+static_assert(static_cast<std::size_t>(ApiRoute::TickProfile) + 1 == STATIC_DATA_ENDPOINT);
+
+struct ApiRouteInfo {
+    std::string_view path;
+    bool has_param;
+    ApiRoute route;
+    std::uint64_t allowed_methods;
+    ApiRequestType request_type;
+    // Ошибка, возвращаемая при недопустимом методе
+    ResponseErrorType method_error;
+};
+
+inline constexpr std::uint64_t GET_HEAD_METHODS = MethodBit(http::verb::get) | MethodBit(http::verb::head);
+inline constexpr std::uint64_t POST_METHOD = MethodBit(http::verb::post);
+
+inline constexpr Router API_ROUTER{std::array{
+    ApiRouteInfo{"/api/v1/game/join"sv, false, ApiRoute::GameJoin, POST_METHOD, 
+                 ApiRequestType::GameJoin, ResponseErrorType::InvalidMethod},
+    ApiRouteInfo{"/api/v1/game/players"sv, false, ApiRoute::Players, GET_HEAD_METHODS, 
+                 ApiRequestType::Players, ResponseErrorType::InvalidMethod},
+    ApiRouteInfo{"/api/v1/game/state"sv, false, ApiRoute::GameState, GET_HEAD_METHODS, 
+                 ApiRequestType::GameState, ResponseErrorType::InvalidMethod},
+    ApiRouteInfo{"/api/v1/game/stream"sv, false, ApiRoute::GameStream, MethodBit(http::verb::get), 
+                 ApiRequestType::Any, ResponseErrorType::BadRequest},
+    ApiRouteInfo{"/api/v1/game/player/action"sv, false, ApiRoute::Action, POST_METHOD, 
+                 ApiRequestType::Action, ResponseErrorType::InvalidMethod},
+    ApiRouteInfo{"/api/v1/game/tick"sv, false, ApiRoute::Tick, POST_METHOD, 
+                 ApiRequestType::Tick, ResponseErrorType::InvalidMethod},
+    ApiRouteInfo{"/api/v1/maps"sv, false, ApiRoute::Maps, GET_HEAD_METHODS, 
+                 ApiRequestType::Maps, ResponseErrorType::BadRequest},
+    // /api/v1/maps/{map_id}
+    ApiRouteInfo{"/api/v1/maps/"sv, true, ApiRoute::Map, GET_HEAD_METHODS, 
+                 ApiRequestType::Map, ResponseErrorType::BadRequest},
+    ApiRouteInfo{"/api/v1/metrics"sv, false, ApiRoute::Metrics, GET_HEAD_METHODS, 
+                 ApiRequestType::Any, ResponseErrorType::BadRequest},
+    ApiRouteInfo{"/api/v1/admin/tick-profile"sv, false, ApiRoute::TickProfile, GET_HEAD_METHODS, 
+                 ApiRequestType::Any, ResponseErrorType::BadRequest}
+}};
+
 class RequestHandler : public std::enable_shared_from_this<RequestHandler> {
 public:
     using Strand = net::strand<net::io_context::executor_type>;
 
-    explicit RequestHandler(Application& app, const std::string &static_data_path, Strand api_strand) :
+    explicit RequestHandler(Application& app, const std::string &static_data_path, Strand api_strand, 
+                            const admission::Limits& limits = {}) :
           app_{app},
           static_data_path_{fs::weakly_canonical(static_data_path)},
-          api_strand_{api_strand}
+          static_files_{static_data_path_, [](const fs::path& file_path) {
+              auto content_type = ContentType::GetContentTypeByFileExtension(file_path);
+              return content_type == ContentType::UNKNOWN ? ContentType::APPLICATION_OCTET_STREAM : content_type;
+          }},
+          api_strand_{api_strand},
+          state_streams_{app},
+          metrics_{std::vector<std::string>(METRICS_ENDPOINTS.begin(), METRICS_ENDPOINTS.end())},
+          limits_{limits},
+          api_budget_{std::make_shared<admission::Budget>(limits.max_api_queue_depth)},
+          static_budget_{std::make_shared<admission::Budget>(limits.max_static_requests)}
     {}
 
     RequestHandler(const RequestHandler&) = delete;
@@ -117,71 +225,160 @@ public:
 
         // 1. API request
         if (request_type == RequestType::Api) {
-            auto handle = [self = shared_from_this(), send, req = std::forward<decltype(req)>(req)] {
+            const DecodedPath path{req.target()};
+            const ApiRouteInfo* route = path.IsValid() ? API_ROUTER.Match(path.View()) : nullptr;
+            // Состояние игры читается из снимков сессий, метрики - из атомарных счётчиков, а профили тиков
+            // из кольцевого буфера, поэтому такие запросы обрабатываются вне strand-а
+            const bool is_off_strand = route && (route->route == ApiRoute::GameState 
+                                                 || route->route == ApiRoute::Players
+                                                 || route->route == ApiRoute::Metrics
+                                                 || route->route == ApiRoute::TickProfile);
+            const auto endpoint = route ? static_cast<std::size_t>(route->route) : OTHER_ENDPOINT;
+            // overloaded - запрос отклоняется без обработки
+            auto handle = [self = shared_from_this(), send, req = std::forward<decltype(req)>(req), route, path, endpoint](bool overloaded) mutable {
                 RequestResponse response;
                 {
-                    MakingResponseDurationLogger durationLogger(response);
-                    response = self->HandleApiRequest(std::forward<decltype(req)>(req));
+                    MakingResponseDurationLogger durationLogger(response, self->metrics_, endpoint, req.payload_size().value_or(0));
+                    if (overloaded) {
+                        response = self->MakeOverloadedResponse(req);
+                    } else {
+                        response = self->HandleApiRequest(std::move(req), route, path);
+                    }
                 }
                 return self->SendResponse(std::move(response), std::move(send));
             };
-            net::dispatch(api_strand_, handle);
+            // Запрос не должен обгонять предыдущие запросы соединения, ожидающие strand-а: иначе при конвейерной
+            // обработке состояние игры, прочитанное после действия игрока, могло бы не содержать этого действия
+            auto& deferred_requests = send.GetDeferredRequests();
+            if (is_off_strand) {
+                deferred_requests.RunInOrder(api_strand_, [handle = std::move(handle)]() mutable {
+                    handle(false);
+                });
+                return;
+            }
+            // Очередь strand-а ограничена: лишние запросы сразу получают 503, не дожидаясь своей очереди
+            auto ticket = api_budget_->TryAcquire();
+            if (!ticket) {
+                handle(true);
+                return;
+            }
+            deferred_requests.Defer(api_strand_, [self = shared_from_this(), handle = std::move(handle), ticket = std::move(ticket),
+                                                  enqueued_at = metrics::RequestMetrics::Clock::now()]() mutable {
+                const auto delay = metrics::RequestMetrics::Clock::now() - enqueued_at;
+                self->metrics_.RecordStrandDelay(delay);
+                // Клиент слишком долго ждал в очереди, ответ ему уже, скорее всего, не нужен
+                const bool expired = self->limits_.max_api_queue_age.count() != 0 && delay > self->limits_.max_api_queue_age;
+                if (expired) {
+                    self->api_budget_->CountRejected();
+                }
+                handle(expired);
+            });
             return;
         }
 
         // 2. Static data request
         if (request_type == RequestType::StaticData) {
             RequestResponse response;
+            // Место в бюджете занято, пока ответ не отправлен: чтение файла с диска и отправка большого
+            // ответа занимают больше времени, чем его подготовка
+            auto ticket = static_budget_->TryAcquire();
             {
-                MakingResponseDurationLogger durationLogger(response);
-                response = HandleStaticDataRequest(std::move(req));
+                MakingResponseDurationLogger durationLogger(response, metrics_, STATIC_DATA_ENDPOINT, req.payload_size().value_or(0));
+                if (ticket) {
+                    response = HandleStaticDataRequest(std::move(req));
+                } else {
+                    response = MakeOverloadedResponse(req);
+                }
             }
-            return SendResponse(std::move(response), std::move(send));
+            return SendResponse(std::move(response), std::move(send), std::move(ticket));
         }
 
         // 3. Bad request
         RequestResponse response;
         {
-            MakingResponseDurationLogger durationLogger(response);
+            MakingResponseDurationLogger durationLogger(response, metrics_, OTHER_ENDPOINT, req.payload_size().value_or(0));
             response = MakeErrorResponse(ResponseErrorType::BadRequest, req);
         }
         return SendResponse(std::move(response), std::move(send));
     }
 
-private:
-    template <typename Body, typename Allocator>
-    StringResponse HandleApiRequest(http::request<Body, http::basic_fields<Allocator>> req) {
-        urls::decode_view url_decoded(req.target());
-
-        if (url_decoded == "/api/v1/game/join"sv) {
-            return HandleGameJoinRequest(req);
+    // Запрос на WebSocket-соединение: /api/v1/game/stream?token=<token> подписывает клиента на состояние игры
+    void operator()(http::request<http::string_body>&& req, http_server::WebSocketUpgrade&& upgrade) {
+        const DecodedPath path{req.target()};
+        const ApiRouteInfo* route = path.IsValid() ? API_ROUTER.Match(path.View()) : nullptr;
+        if (!route || route->route != ApiRoute::GameStream) {
+            // Заголовок Upgrade у обычного запроса игнорируем
+            http_server::ResponseSender send = std::move(upgrade);
+            return (*this)(std::move(req), std::move(send));
         }
-        if (url_decoded == "/api/v1/game/players"sv) {
-            return HandlePlayersRequest(req);
+
+        // Браузер не позволяет задать заголовки WebSocket-запроса, поэтому токен можно передать в параметре token
+        auto token = TryExtractToken(req[http::field::authorization]);
+        if (!token) {
+            token = TryExtractQueryToken(path.Query());
         }
-        if (url_decoded == "/api/v1/game/state"sv) {
-            return HandleGameStateRequest(req);
+        if (!token) {
+            return upgrade(MakeErrorResponse(ResponseErrorType::InvalidAuthorization, req, ApiRequestType::GameState));
         }
-        if (url_decoded == "/api/v1/game/player/action"sv) {
-            return HandleActionRequest(req);
+        try {
+            app_.GetSerializedGameState(*token);
+        } catch (const AppErrorException& e) {
+            return upgrade(MakeErrorResponse(e.GetCategory(), req, ApiRequestType::GameState));
         }
-        if (url_decoded == "/api/v1/game/tick"sv) {
-            return HandleTickRequest(req);
+
+        upgrade.Accept(std::move(req), [self = shared_from_this(), token = std::move(*token)](auto stream) {
+            net::dispatch(self->api_strand_, [self, token, stream = std::move(stream)] {
+                self->state_streams_.Subscribe(token, stream);
+            });
+        });
+    }
+
+    // Рассылает состояние игры подписчикам. Вызывается внутри strand-а API после тика
+    void PushGameState() {
+        assert(api_strand_.running_in_this_thread());
+        state_streams_.Push();
+    }
+
+private:
+    template <typename Body, typename Allocator>
+    RequestResponse HandleApiRequest(http::request<Body, http::basic_fields<Allocator>> req, 
+                                     const ApiRouteInfo* route, 
+                                     const DecodedPath& path) {
+        if (!route) {
+            return MakeErrorResponse(ResponseErrorType::BadRequest, req);
         }
-        if (url_decoded == "/api/v1/maps"sv) {
-            return HandleMapsRequest(req);
+        if (!(route->allowed_methods & MethodBit(req.method()))) {
+            return MakeErrorResponse(route->method_error, req, route->request_type);
         }
 
-        // /api/v1/maps/{map_id}
-        return HandleMapRequest(req);
+        switch (route->route) {
+            case ApiRoute::GameJoin:
+                return HandleGameJoinRequest(req);
+            case ApiRoute::Players:
+                return HandlePlayersRequest(req);
+            case ApiRoute::GameState:
+                return HandleGameStateRequest(req, path.Query());
+            case ApiRoute::Action:
+                return HandleActionRequest(req);
+            case ApiRoute::Tick:
+                return HandleTickRequest(req);
+            case ApiRoute::Maps:
+                return HandleMapsRequest(req);
+            case ApiRoute::Map:
+                return HandleMapRequest(req, API_ROUTER.GetParam(*route, path.View()));
+            case ApiRoute::Metrics:
+                return HandleMetricsRequest(req);
+            case ApiRoute::TickProfile:
+                return HandleTickProfileRequest(req, path.Query());
+            case ApiRoute::GameStream:
+                // Подписка возможна только через WebSocket
+                break;
+        }
+        return MakeErrorResponse(ResponseErrorType::BadRequest, req);
     }
 
     template <typename Body, typename Allocator>
     StringResponse HandleGameJoinRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
-        if (req.method() != http::verb::post) {
-            return MakeErrorResponse(ResponseErrorType::InvalidMethod, req, ApiRequestType::GameJoin);
-        }
-
         std::string user_name, map_id;
         try {
             auto params = json::parse(req.body());
@@ -201,11 +398,7 @@ private:
     }
 
     template <typename Body, typename Allocator>
-    StringResponse HandlePlayersRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
-        if (req.method() != http::verb::get && req.method() != http::verb::head) {
-            return MakeErrorResponse(ResponseErrorType::InvalidMethod, req, ApiRequestType::Players);
-        }
-
+    RequestResponse HandlePlayersRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
         return ExecuteAuthorized(req, [&req, this](const auto& token) {
             json::value players_state;
             try {
@@ -218,27 +411,43 @@ private:
     }
 
     template <typename Body, typename Allocator>
-    StringResponse HandleGameStateRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
-        if (req.method() != http::verb::get && req.method() != http::verb::head) {
-            return MakeErrorResponse(ResponseErrorType::InvalidMethod, req, ApiRequestType::GameState);
+    RequestResponse HandleGameStateRequest(http::request<Body, http::basic_fields<Allocator>>& req, std::string_view query) {
+        // ?since=<tick> - только изменения после указанного тика
+        std::optional<std::uint64_t> since_tick;
+        const auto params = ParseQuery(query);
+        if (!params) {
+            return MakeErrorResponse(ResponseErrorType::BadRequest, req, ApiRequestType::GameState);
         }
-        
-        return ExecuteAuthorized(req, [&req, this](const auto& token) {
-            json::value game_state;
+        if (auto since_param = params->find("since"sv); since_param != params->end()) {
+            since_tick = ParseTick((*since_param).value);
+            if (!since_tick) {
+                return MakeErrorResponse(ResponseErrorType::BadRequest, req, ApiRequestType::GameState);
+            }
+        }
+
+        return ExecuteAuthorized(req, [&req, &since_tick, this](const auto& token) -> RequestResponse {
+            if (since_tick) {
+                json::value game_state_changes;
+                try {
+                    game_state_changes = app_.GetGameStateChanges(token, *since_tick);
+                } catch (const AppErrorException& e) {
+                    return MakeErrorResponse(e.GetCategory(), req, ApiRequestType::GameState);
+                }
+                return MakeStringResponse(http::status::ok, json::serialize(game_state_changes), req);
+            }
+
+            std::shared_ptr<const std::string> game_state;
             try {
-                game_state = app_.GetGameState(token);
+                game_state = app_.GetSerializedGameState(token);
             } catch (const AppErrorException& e) { 
                 return MakeErrorResponse(e.GetCategory(), req, ApiRequestType::GameState);
             }
-            return MakeStringResponse(http::status::ok, json::serialize(game_state), req);
+            return MakeSharedStringResponse(http::status::ok, std::move(game_state), req);
         }, ApiRequestType::GameState);
     }
 
     template <typename Body, typename Allocator>
-    StringResponse HandleActionRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
-        if (req.method() != http::verb::post) {
-            return MakeErrorResponse(ResponseErrorType::InvalidMethod, req, ApiRequestType::Action);
-        }
+    RequestResponse HandleActionRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
         if (boost::algorithm::to_lower_copy(std::string(req[http::field::content_type])) != ContentType::APPLICATION_JSON) {
             return MakeErrorResponse(ResponseErrorType::InvalidContentType, req, ApiRequestType::Action);
         }
@@ -263,9 +472,6 @@ private:
 
     template <typename Body, typename Allocator>
     StringResponse HandleTickRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
-        if (req.method() != http::verb::post) {
-            return MakeErrorResponse(ResponseErrorType::InvalidMethod, req, ApiRequestType::Tick);
-        }
         if (app_.GetAutoTick()) {
             return MakeErrorResponse(ResponseErrorType::BadRequest, req, ApiRequestType::Tick);
         }
@@ -283,67 +489,108 @@ private:
         } catch (const AppErrorException& e) { 
             return MakeErrorResponse(e.GetCategory(), req, ApiRequestType::Tick);
         }
+        state_streams_.Push();
         return MakeStringResponse(http::status::ok, json::serialize(json::object{}), req);
     }
 
     template <typename Body, typename Allocator>
-    StringResponse HandleMapsRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
-        if (req.method() != http::verb::get && req.method() != http::verb::head) {
-            return MakeErrorResponse(ResponseErrorType::BadRequest, req, ApiRequestType::Maps);
-        }
-        return MakeStringResponse(http::status::ok, json::serialize(app_.GetMapsShortInfo()), req);
+    StringResponse HandleMetricsRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
+        const metrics::RequestMetrics::Gauges gauges{
+            {"game_server_open_connections"sv, http_server::OpenConnection::GetCount()},
+            {"game_server_api_queue_depth"sv, static_cast<std::int64_t>(api_budget_->GetInUse())}
+        };
+        const metrics::RequestMetrics::Counters counters{
+            {"game_server_dropped_log_records"sv, json_logger::GetDroppedRecordCount()},
+            {"game_server_rejected_connections"sv, http_server::GetRejectedConnectionCount()},
+            {"game_server_rejected_api_requests"sv, api_budget_->GetRejectedCount()},
+            {"game_server_rejected_static_requests"sv, static_budget_->GetRejectedCount()}
+        };
+        return MakeStringResponse(http::status::ok, metrics_.FormatPrometheus(gauges, counters), req, "text/plain; version=0.0.4"sv);
     }
 
+    // ?format=folded - свёрнутые стеки для flamegraph.pl, иначе сводка в JSON
     template <typename Body, typename Allocator>
-    StringResponse HandleMapRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
-        if (req.method() != http::verb::get && req.method() != http::verb::head) {
-            return MakeErrorResponse(ResponseErrorType::BadRequest, req, ApiRequestType::Map);
+    StringResponse HandleTickProfileRequest(http::request<Body, http::basic_fields<Allocator>>& req, std::string_view query) {
+        const auto params = ParseQuery(query);
+        if (!params) {
+            return MakeErrorResponse(ResponseErrorType::BadRequest, req);
         }
-        
-        urls::decode_view url_decoded(req.target());
-
-        static const auto map_id_regex = std::regex(R"(/api/v1/maps/(.+))");
-        std::smatch match_results;
-        std::string target_name(url_decoded.begin(), url_decoded.end());
-        if (!regex_match(target_name, match_results, map_id_regex)) {
-            return MakeErrorResponse(ResponseErrorType::InvalidMapId, req, ApiRequestType::Map);
+        const auto& profiler = app_.GetTickProfiler();
+        auto format = params->find("format"sv);
+        if (format == params->end() || (*format).value == "json"sv) {
+            return MakeStringResponse(http::status::ok, json::serialize(profiler.ToJson()), req);
         }
-        
-        json::value map_info;
+        if ((*format).value == "folded"sv) {
+            return MakeStringResponse(http::status::ok, profiler.ToFoldedStacks(), req, ContentType::TEXT_PLAIN);
+        }
+        return MakeErrorResponse(ResponseErrorType::BadRequest, req);
+    }
+
+    template <typename Body, typename Allocator>
+    RequestResponse HandleMapsRequest(http::request<Body, http::basic_fields<Allocator>>& req) {
+        return MakeSerializedJsonResponse(app_.GetMapsShortInfo(), req);
+    }
+
+    template <typename Body, typename Allocator>
+    RequestResponse HandleMapRequest(http::request<Body, http::basic_fields<Allocator>>& req, std::string_view map_id) {
         try {
-            map_info = app_.GetMapInfo(match_results[1]);
+            return MakeSerializedJsonResponse(app_.GetMapInfo(map_id), req);
         } catch (const AppErrorException& e) { 
             return MakeErrorResponse(ResponseErrorType::MapNotFound, req, ApiRequestType::Map);
         }
-
-        return MakeStringResponse(http::status::ok, json::serialize(map_info), req);
     }
 
     template <typename Body, typename Allocator>
     RequestResponse HandleStaticDataRequest(http::request<Body, http::basic_fields<Allocator>>&& req) {
-        urls::decode_view url_decoded(req.target());
+        urls::decode_view url_decoded(GetTargetPath(req));
 
-        fs::path req_path{"." + std::string(url_decoded.begin(), url_decoded.end())};
-        fs::path abs_path = fs::weakly_canonical(static_data_path_ / req_path);
-        if (!IsSubPath(abs_path, static_data_path_)) {
+        auto file_key = static_files::StaticFileCache::MakeKey(std::string(url_decoded.begin(), url_decoded.end()));
+        if (!file_key) {
             return MakeErrorResponse(ResponseErrorType::StaticDataFileNotSubPath, req);
         }
-
-        if (fs::exists(abs_path) && fs::is_directory(abs_path)) {
-            abs_path = fs::weakly_canonical(abs_path / "./index.html"s);
+        auto cached_file = static_files_.Find(*file_key);
+        if (!cached_file) {
+            return MakeErrorResponse(ResponseErrorType::StaticDataFileNotFound, req);
         }
 
-        http::file_body::value_type file;
-        if (sys::error_code ec; file.open(abs_path.c_str(), beast::file_mode::read, ec), ec) {
-            return MakeErrorResponse(ResponseErrorType::StaticDataFileNotFound, req);
+        const auto& file_info = *cached_file->info;
+        const bool use_gzip = cached_file->gzip_body && IsGzipAccepted(req[http::field::accept_encoding]);
+        const auto& etag = use_gzip ? file_info.gzip_etag : file_info.etag;
+        auto set_cache_headers = [&](auto& response) {
+            response.set(http::field::etag, etag);
+            response.set(http::field::last_modified, file_info.last_modified);
+            if (cached_file->gzip_body) {
+                response.set(http::field::vary, "Accept-Encoding"sv);
+            }
+        };
+
+        if (IsETagMatched(req[http::field::if_none_match], etag)) {
+            auto response = MakeNotModifiedResponse(etag, req);
+            set_cache_headers(response);
+            return response;
         }
 
-        auto content_type = ContentType::GetContentTypeByFileExtension(abs_path);
-        if (content_type == ContentType::UNKNOWN) {
-            content_type = ContentType::APPLICATION_OCTET_STREAM;
+        // Файл есть в памяти: отдаём общий буфер без копирования
+        if (cached_file->body) {
+            SharedStringResponse response(http::status::ok, req.version());
+            response.body() = use_gzip ? cached_file->gzip_body : cached_file->body;
+            response.content_length(response.body()->size());
+            response.keep_alive(req.keep_alive());
+            response.set(http::field::content_type, file_info.content_type);
+            if (use_gzip) {
+                response.set(http::field::content_encoding, "gzip"sv);
+            }
+            set_cache_headers(response);
+            return response;
         }
 
-        return MakeFileResponse(http::status::ok, std::move(file), req, content_type);
+        http::file_body::value_type file;
+        if (sys::error_code ec; file.open(file_info.path.c_str(), beast::file_mode::read, ec), ec) {
+            return MakeErrorResponse(ResponseErrorType::StaticDataFileNotFound, req);
+        }
+        auto response = MakeFileResponse(http::status::ok, std::move(file), req, file_info.content_type);
+        set_cache_headers(response);
+        return response;
     }
 
 private:
@@ -388,16 +635,53 @@ private:
     }
 
     template <typename Fn, typename Body, typename Allocator>
-    static StringResponse ExecuteAuthorized(http::request<Body, http::basic_fields<Allocator>>& req, 
+    static RequestResponse ExecuteAuthorized(http::request<Body, http::basic_fields<Allocator>>& req, 
                                             Fn&& action, 
                                             ApiRequestType request_type) {
-        if (auto token = TryExtractToken(std::string(req[http::field::authorization]))) {
+        if (auto token = TryExtractToken(req[http::field::authorization])) {
             return action(*token);
         } else {
             return MakeErrorResponse(ResponseErrorType::InvalidAuthorization, req, request_type);
         }
     }
     
+    template <typename Body, typename Allocator>
+    static SharedStringResponse MakeSharedStringResponse(http::status status, 
+                                                         std::shared_ptr<const std::string> body, 
+                                                         http::request<Body, http::basic_fields<Allocator>>& request,
+                                                         std::string_view content_type = ContentType::APPLICATION_JSON) {
+        SharedStringResponse response(status, request.version());
+        response.content_length(body->size());
+        response.body() = std::move(body);
+        response.keep_alive(request.keep_alive());
+        response.set(http::field::content_type, content_type);
+        response.set(http::field::cache_control, "no-cache"sv);
+        return response;
+    }
+
+    // Ответ с неизменяемым телом: 304 Not Modified, если у клиента уже есть эта версия (If-None-Match)
+    template <typename Body, typename Allocator>
+    static RequestResponse MakeSerializedJsonResponse(const SerializedJson& serialized_json, 
+                                                      http::request<Body, http::basic_fields<Allocator>>& request) {
+        if (IsETagMatched(request[http::field::if_none_match], serialized_json.etag)) {
+            auto response = MakeNotModifiedResponse(serialized_json.etag, request);
+            response.set(http::field::cache_control, "no-cache"sv);
+            return response;
+        }
+        auto response = MakeSharedStringResponse(http::status::ok, serialized_json.body, request);
+        response.set(http::field::etag, serialized_json.etag);
+        return response;
+    }
+
+    template <typename Body, typename Allocator>
+    static StringResponse MakeNotModifiedResponse(std::string_view etag, 
+                                                  http::request<Body, http::basic_fields<Allocator>>& request) {
+        StringResponse response(http::status::not_modified, request.version());
+        response.keep_alive(request.keep_alive());
+        response.set(http::field::etag, etag);
+        return response;
+    }
+
     template <typename Body, typename Allocator>
     static FileResponse MakeFileResponse(http::status status, 
                                          http::file_body::value_type&& file, 
@@ -453,6 +737,15 @@ private:
         }
         case ApiRequestType::GameState: {
             switch (error_type) {
+                case ResponseErrorType::BadRequest: {
+                    result = MakeStringResponse<Body, Allocator>(http::status::bad_request, 
+                                                                json::serialize(json::object{
+                                                                    {"code"sv, "invalidArgument"sv}, 
+                                                                    {"message"sv, "Invalid since parameter"sv}
+                                                                }), 
+                                                                req);
+                    break;
+                }
                 case ResponseErrorType::InvalidMethod: {
                     result = MakeStringResponse<Body, Allocator>(http::status::method_not_allowed, 
                                                                 json::serialize(json::object{
@@ -716,32 +1009,92 @@ private:
         return MakeErrorResponse(err_category_to_err_type.at(error_category), req, request_type);
     }
 
-    template <typename Send>
-    void SendResponse(RequestResponse&& response, Send&& send) {
+    // 503 Service Unavailable при превышении ограничений нагрузки
+    template <typename Body, typename Allocator>
+    StringResponse MakeOverloadedResponse(http::request<Body, http::basic_fields<Allocator>>& req) const {
+        auto response = MakeStringResponse(http::status::service_unavailable, 
+                                           json::serialize(json::object{
+                                               {"code"sv, "serviceUnavailable"sv}, 
+                                               {"message"sv, "Server is overloaded, retry later"sv}
+                                           }), 
+                                           req);
+        response.set(http::field::retry_after, std::to_string(limits_.retry_after.count()));
+        return response;
+    }
+
+    // attachment передаётся отправителю ответа и живёт, пока ответ отправляется
+    template <typename Send, typename... Attachment>
+    void SendResponse(RequestResponse&& response, Send&& send, Attachment&&... attachment) {
         if (holds_alternative<StringResponse>(response)) {
-            send(get<StringResponse>(response));
+            send(get<StringResponse>(response), std::move(attachment)...);
         } else if (holds_alternative<FileResponse>(response)) {
-            send(get<FileResponse>(response));
+            send(get<FileResponse>(response), std::move(attachment)...);
+        } else if (holds_alternative<SharedStringResponse>(response)) {
+            send(get<SharedStringResponse>(response), std::move(attachment)...);
         }
     }
 
 private:
-    static bool IsSubPath(fs::path path, fs::path base);
-    static std::optional<std::string> TryExtractToken(std::string&& auth_header);
+    static std::optional<players::Token> TryExtractToken(std::string_view auth_header);
+    static bool IsETagMatched(std::string_view if_none_match, std::string_view etag);
+    static bool IsGzipAccepted(std::string_view accept_encoding);
+
+    // Параметры из строки параметров запроса (DecodedPath::Query). nullopt - строка параметров некорректна
+    static std::optional<urls::params_view> ParseQuery(std::string_view query) {
+        auto params = urls::parse_query(query);
+        if (!params) {
+            return std::nullopt;
+        }
+        return urls::params_view(*params);
+    }
+
+    static std::optional<players::Token> TryExtractQueryToken(std::string_view query) {
+        const auto params = ParseQuery(query);
+        if (!params) {
+            return {};
+        }
+        auto token_param = params->find("token"sv);
+        if (token_param == params->end()) {
+            return {};
+        }
+        return players::Token::FromString((*token_param).value);
+    }
 
     template <typename Body, typename Allocator>
     static RequestType CheckRequestType(const http::request<Body, http::basic_fields<Allocator>> &req) {
-        urls::decode_view url_decoded(req.target());
-        if (url_decoded.starts_with("/api/"sv)) {
+        if (req.target().starts_with("/api/"sv)) {
             return RequestType::Api;
         }        
         return RequestType::StaticData;
     }
 
+    // Путь запроса без строки параметров
+    template <typename Body, typename Allocator>
+    static std::string_view GetTargetPath(const http::request<Body, http::basic_fields<Allocator>> &req) {
+        std::string_view target = req.target();
+        return target.substr(0, target.find('?'));
+    }
+
+    static std::optional<std::uint64_t> ParseTick(std::string_view tick_str) {
+        std::uint64_t tick = 0;
+        auto [ptr, ec] = std::from_chars(tick_str.data(), tick_str.data() + tick_str.size(), tick);
+        if (ec != std::errc{} || ptr != tick_str.data() + tick_str.size()) {
+            return std::nullopt;
+        }
+        return tick;
+    }
+
 private:
     Application& app_;
     fs::path static_data_path_;
+    static_files::StaticFileCache static_files_;
     Strand api_strand_;
+    GameStateStreams state_streams_;
+    metrics::RequestMetrics metrics_;
+    admission::Limits limits_;
+    // Запросы API в очереди strand-а и выполняющиеся в нём
+    std::shared_ptr<admission::Budget> api_budget_;
+    std::shared_ptr<admission::Budget> static_budget_;
 };
 
 }  // namespace http_handler
@@ -0,0 +1,52 @@
+#pragma once
+
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <memory>
+#include <string>
+
+namespace http_server {
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+// Тело ответа, ссылающееся на общую неизменяемую строку: один раз подготовленные данные
+// отправляются любому числу клиентов без копирования
+struct SharedStringBody {
+    using value_type = std::shared_ptr<const std::string>;
+
+    static std::uint64_t size(const value_type& body) noexcept {
+        return body ? body->size() : 0;
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template <bool isRequest, typename Fields>
+        writer(const http::header<isRequest, Fields>&, const value_type& body)
+            : body_(body) {
+        }
+
+        void init(beast::error_code& ec) {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            if (!body_) {
+                return boost::none;
+            }
+            return {{const_buffers_type{body_->data(), body_->size()}, false}};
+        }
+
+    private:
+        const value_type& body_;
+    };
+};
+
+}  // namespace http_server
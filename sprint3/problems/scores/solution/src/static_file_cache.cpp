@@ -0,0 +1,277 @@
+#include "static_file_cache.h"
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace static_files {
+
+using namespace std::literals;
+
+StaticFileCache::StaticFileCache(fs::path root, ContentTypeResolver content_type_resolver, Options options)
+    : root_{fs::weakly_canonical(root)}
+    , content_type_resolver_{std::move(content_type_resolver)}
+    , options_{options} {
+    Index();
+}
+
+std::optional<std::string> StaticFileCache::MakeKey(std::string_view request_path) {
+    auto key = fs::path("."s + std::string(request_path)).lexically_normal().generic_string();
+    if (key == "."sv) {
+        return ""s;
+    }
+    if (key == ".."sv || key.starts_with("../"sv)) {
+        return std::nullopt;
+    }
+    while (key.ends_with('/')) {
+        key.pop_back();
+    }
+    return key;
+}
+
+std::optional<StaticFileCache::File> StaticFileCache::Find(const std::string& key) {
+    std::shared_ptr<const FileInfo> info;
+    {
+        std::unique_lock lock{mutex_};
+        Entry* entry = FindFreshEntry(key, lock);
+        if (!entry) {
+            return std::nullopt;
+        }
+        if (entry->body || !IsCacheable(*entry->info)) {
+            Touch(*entry);
+            return File{entry->info, entry->body, entry->gzip_body};
+        }
+        info = entry->info;
+    }
+
+    // Чтение и сжатие файла выполняются вне блокировки, чтобы не задерживать другие запросы
+    auto file = Load(info);
+    if (file.body) {
+        Store(file);
+    }
+    return file;
+}
+
+void StaticFileCache::Index() {
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(root_, fs::directory_options::skip_permission_denied, ec), end;
+         !ec && it != end; it.increment(ec)) {
+        if (!it->is_regular_file(ec)) {
+            continue;
+        }
+        auto info = ReadFileInfo(it->path().lexically_relative(root_).generic_string());
+        if (!info) {
+            continue;
+        }
+
+        auto& entry = entries_[info->key];
+        entry.info = info;
+        entry.checked_at = Clock::now();
+        if (IsCacheable(*info) && memory_size_ + info->size <= options_.max_memory_size) {
+            if (auto file = Load(info); file.body) {
+                Store(file);
+            }
+        }
+    }
+}
+
+StaticFileCache::Entry* StaticFileCache::FindFreshEntry(const std::string& key, std::unique_lock<std::mutex>& lock) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        it = entries_.find(IndexFileKey(key));
+    }
+
+    const auto now = Clock::now();
+    if (it != entries_.end()) {
+        if (now - it->second.checked_at < options_.refresh_period) {
+            return &it->second;
+        }
+    } else if (auto miss = misses_.find(key); miss != misses_.end() && now - miss->second < options_.refresh_period) {
+        return nullptr;
+    }
+
+    // Файл мог появиться, измениться или быть удалён. Пока файл проверяется на диске,
+    // другие запросы обслуживаются, поэтому после проверки записи ищутся заново
+    const auto checked_key = it != entries_.end() ? it->first : key;
+    lock.unlock();
+    auto info = ReadFileInfo(checked_key);
+    lock.lock();
+
+    if (!info) {
+        if (it = entries_.find(checked_key); it != entries_.end() && it->second.checked_at < now) {
+            DropBody(it->second);
+            entries_.erase(it);
+        }
+        RememberMiss(key, now);
+        return nullptr;
+    }
+
+    misses_.erase(key);
+    auto& entry = entries_[info->key];
+    // Запись могла быть обновлена по результатам более поздней проверки
+    if (entry.info && entry.checked_at >= now) {
+        return &entry;
+    }
+    if (!entry.info || entry.info->size != info->size || entry.info->write_time != info->write_time) {
+        DropBody(entry);
+        entry.info = std::move(info);
+    }
+    entry.checked_at = now;
+    return &entry;
+}
+
+void StaticFileCache::RememberMiss(const std::string& key, Clock::time_point checked_at) {
+    if (misses_.size() >= options_.max_remembered_misses && !misses_.contains(key)) {
+        std::erase_if(misses_, [this, checked_at](const auto& miss) {
+            return checked_at - miss.second >= options_.refresh_period;
+        });
+        // Все запомненные промахи свежие: запросы к множеству разных отсутствующих файлов
+        // не должны неограниченно расходовать память
+        if (misses_.size() >= options_.max_remembered_misses) {
+            misses_.clear();
+        }
+    }
+    misses_[key] = checked_at;
+}
+
+std::shared_ptr<const FileInfo> StaticFileCache::ReadFileInfo(std::string key) const {
+    std::error_code ec;
+    fs::path path = key.empty() ? root_ : root_ / key;
+    auto status = fs::status(path, ec);
+    if (fs::is_directory(status)) {
+        key = IndexFileKey(key);
+        path = root_ / key;
+        status = fs::status(path, ec);
+    }
+    if (!fs::is_regular_file(status)) {
+        return nullptr;
+    }
+    // Ключ нормализуется только лексически, а символическая ссылка внутри корня может вести
+    // за его пределы, поэтому проверяется путь после раскрытия всех ссылок
+    path = fs::canonical(path, ec);
+    if (ec) {
+        return nullptr;
+    }
+    if (const auto relative = path.lexically_relative(root_); relative.empty() || *relative.begin() == ".."sv) {
+        return nullptr;
+    }
+
+    auto info = std::make_shared<FileInfo>();
+    info->size = fs::file_size(path, ec);
+    if (ec) {
+        return nullptr;
+    }
+    info->write_time = fs::last_write_time(path, ec);
+    if (ec) {
+        return nullptr;
+    }
+    info->content_type = content_type_resolver_(path);
+
+    // Строгий ETag по времени изменения и размеру файла (как у nginx)
+    std::ostringstream etag;
+    etag << '"' << std::hex << info->write_time.time_since_epoch().count() << '-' << info->size << '"';
+    info->etag = etag.str();
+    info->gzip_etag = info->etag.substr(0, info->etag.size() - 1) + "-gz\""s;
+
+    using namespace std::chrono;
+    const std::time_t write_time = system_clock::to_time_t(
+        time_point_cast<system_clock::duration>(file_clock::to_sys(info->write_time)));
+    std::tm write_tm{};
+    gmtime_r(&write_time, &write_tm);
+    char last_modified[64];
+    info->last_modified.assign(last_modified,
+                               std::strftime(last_modified, sizeof(last_modified), "%a, %d %b %Y %H:%M:%S GMT", &write_tm));
+
+    info->key = std::move(key);
+    info->path = std::move(path);
+    return info;
+}
+
+bool StaticFileCache::IsCacheable(const FileInfo& info) const noexcept {
+    return info.size <= options_.max_file_size && info.size <= options_.max_memory_size;
+}
+
+StaticFileCache::File StaticFileCache::Load(const std::shared_ptr<const FileInfo>& info) {
+    std::ifstream file(info->path, std::ios::binary);
+    std::string data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if (!file && !file.eof()) {
+        return File{info, nullptr, nullptr};
+    }
+
+    std::shared_ptr<const std::string> gzip_body;
+    if (IsCompressible(info->content_type)) {
+        gzip_body = Compress(data);
+        // Сжатый вариант имеет смысл, только если он заметно меньше исходного файла
+        if (gzip_body->size() * 10 > data.size() * 9) {
+            gzip_body.reset();
+        }
+    }
+    return File{info, std::make_shared<const std::string>(std::move(data)), std::move(gzip_body)};
+}
+
+void StaticFileCache::Store(const File& file) {
+    std::lock_guard lock{mutex_};
+    auto it = entries_.find(file.info->key);
+    // Файл успел измениться или уже загружен другим потоком
+    if (it == entries_.end() || it->second.info != file.info || it->second.body) {
+        return;
+    }
+
+    auto& entry = it->second;
+    entry.body = file.body;
+    entry.gzip_body = file.gzip_body;
+    entry.lru_position = lru_.insert(lru_.begin(), it->first);
+    memory_size_ += entry.body->size() + (entry.gzip_body ? entry.gzip_body->size() : 0);
+
+    while (memory_size_ > options_.max_memory_size && !lru_.empty()) {
+        DropBody(entries_.at(lru_.back()));
+    }
+}
+
+void StaticFileCache::Touch(Entry& entry) {
+    if (entry.lru_position) {
+        lru_.splice(lru_.begin(), lru_, *entry.lru_position);
+    }
+}
+
+void StaticFileCache::DropBody(Entry& entry) {
+    if (!entry.lru_position) {
+        return;
+    }
+    memory_size_ -= entry.body->size() + (entry.gzip_body ? entry.gzip_body->size() : 0);
+    lru_.erase(*entry.lru_position);
+    entry.lru_position.reset();
+    entry.body.reset();
+    entry.gzip_body.reset();
+}
+
+std::string StaticFileCache::IndexFileKey(const std::string& key) {
+    return key.empty() ? "index.html"s : key + "/index.html"s;
+}
+
+bool StaticFileCache::IsCompressible(std::string_view content_type) noexcept {
+    return content_type.starts_with("text/"sv)
+        || content_type == "application/json"sv
+        || content_type == "application/xml"sv
+        || content_type == "image/svg+xml"sv;
+}
+
+std::shared_ptr<const std::string> StaticFileCache::Compress(const std::string& data) {
+    namespace io = boost::iostreams;
+
+    std::string compressed;
+    {
+        io::filtering_ostream out;
+        out.push(io::gzip_compressor(io::gzip_params(io::gzip::best_compression)));
+        out.push(io::back_inserter(compressed));
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    return std::make_shared<const std::string>(std::move(compressed));
+}
+
+}  // namespace static_files
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace static_files {
+
+namespace fs = std::filesystem;
+
+// Неизменяемые сведения о версии файла
+struct FileInfo {
+    // Путь относительно корня статических файлов ("js/game.js")
+    std::string key;
+    fs::path path;
+    std::string content_type;
+    std::string etag;
+    // ETag сжатого варианта (у разных кодировок должны быть разные строгие ETag)
+    std::string gzip_etag;
+    std::string last_modified;
+    std::uintmax_t size = 0;
+    fs::file_time_type write_time;
+};
+
+/*
+ * Кеш статических файлов.
+ * При создании индексирует каталог и загружает файлы в память (вместе со сжатыми gzip вариантами
+ * текстовых файлов), пока хватает лимита памяти. Тела файлов вытесняются по LRU и загружаются снова
+ * при обращении. Сведения о файле (и об его отсутствии) перепроверяются на диске не чаще refresh_period,
+ * поэтому изменённые, новые и удалённые файлы подхватываются без перезапуска сервера.
+ * Обращения к диску выполняются вне блокировки кеша.
+ * Методы можно вызывать из разных потоков
+ */
+class StaticFileCache {
+public:
+    using ContentTypeResolver = std::function<std::string_view(const fs::path& file_path)>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        // Суммарный размер тел файлов в памяти
+        std::size_t max_memory_size = 64 * 1024 * 1024;
+        // Файлы больше этого размера отдаются с диска
+        std::size_t max_file_size = 16 * 1024 * 1024;
+        std::chrono::milliseconds refresh_period{1000};
+        // Сколько отсутствующих файлов запоминается, чтобы повторные запросы к ним не обращались к диску
+        std::size_t max_remembered_misses = 4096;
+    };
+
+    struct File {
+        std::shared_ptr<const FileInfo> info;
+        // nullptr - файл нужно читать с диска (info->path)
+        std::shared_ptr<const std::string> body;
+        // nullptr - сжатого варианта нет
+        std::shared_ptr<const std::string> gzip_body;
+    };
+
+    StaticFileCache(fs::path root, ContentTypeResolver content_type_resolver, Options options);
+    StaticFileCache(fs::path root, ContentTypeResolver content_type_resolver)
+        : StaticFileCache(std::move(root), std::move(content_type_resolver), Options{}) {
+    }
+
+    StaticFileCache(const StaticFileCache&) = delete;
+    StaticFileCache& operator=(const StaticFileCache&) = delete;
+
+    // Ключ файла по декодированному пути запроса или nullopt, если путь выходит за пределы корня
+    static std::optional<std::string> MakeKey(std::string_view request_path);
+
+    // Для каталога возвращает его index.html
+    std::optional<File> Find(const std::string& key);
+
+private:
+    struct Entry {
+        std::shared_ptr<const FileInfo> info;
+        std::shared_ptr<const std::string> body;
+        std::shared_ptr<const std::string> gzip_body;
+        Clock::time_point checked_at;
+        std::optional<std::list<std::string>::iterator> lru_position;
+    };
+    using Entries = std::unordered_map<std::string, Entry>;
+
+    void Index();
+    // Может временно освободить lock, чтобы перепроверить файл на диске
+    Entry* FindFreshEntry(const std::string& key, std::unique_lock<std::mutex>& lock);
+    void RememberMiss(const std::string& key, Clock::time_point checked_at);
+    std::shared_ptr<const FileInfo> ReadFileInfo(std::string key) const;
+    bool IsCacheable(const FileInfo& info) const noexcept;
+    File Load(const std::shared_ptr<const FileInfo>& info);
+    void Store(const File& file);
+    void Touch(Entry& entry);
+    void DropBody(Entry& entry);
+
+    static std::string IndexFileKey(const std::string& key);
+    static bool IsCompressible(std::string_view content_type) noexcept;
+    static std::shared_ptr<const std::string> Compress(const std::string& data);
+
+private:
+    fs::path root_;
+    ContentTypeResolver content_type_resolver_;
+    Options options_;
+
+    std::mutex mutex_;
+    Entries entries_;
+    // Ключи файлов, тела которых загружены в память, от недавно использованных к давно использованным
+    std::list<std::string> lru_;
+    std::size_t memory_size_ = 0;
+    // Время проверки ключей, по которым файлов не нашлось
+    std::unordered_map<std::string, Clock::time_point> misses_;
+};
+
+}  // namespace static_files
@@ -0,0 +1,178 @@
+#include "tick_profiler.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <utility>
+
+namespace tick_profiler {
+
+using namespace std::literals;
+
+namespace {
+
+double ToMicroseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Среднее и максимальное значение длительности
+class DurationStats {
+public:
+    void Add(Clock::duration duration) noexcept {
+        total_ += duration;
+        max_ = std::max(max_, duration);
+        ++count_;
+    }
+
+    Clock::duration GetTotal() const noexcept {
+        return total_;
+    }
+
+    json::object ToJson() const {
+        return json::object{
+            {"avgUs"sv, count_ ? ToMicroseconds(total_) / static_cast<double>(count_) : 0.0},
+            {"maxUs"sv, ToMicroseconds(max_)}
+        };
+    }
+
+private:
+    Clock::duration total_{};
+    Clock::duration max_{};
+    std::size_t count_ = 0;
+};
+
+using PhaseStats = std::array<DurationStats, PHASE_COUNT>;
+
+json::object PhaseStatsToJson(const PhaseStats& stats, Phase first, Phase last) {
+    json::object result;
+    for (auto i = static_cast<std::size_t>(first); i <= static_cast<std::size_t>(last); ++i) {
+        result[PHASE_NAMES[i]] = stats[i].ToJson();
+    }
+    return result;
+}
+
+}  // namespace
+
+TickProfiler::TickProfiler(std::size_t depth)
+    : ring_(depth) {
+}
+
+std::unique_ptr<TickProfile> TickProfiler::BeginTick() const {
+    if (ring_.empty()) {
+        return nullptr;
+    }
+    auto profile = std::make_unique<TickProfile>();
+    profile->tick = tick_count_.load(std::memory_order_relaxed);
+    profile->start = Clock::now();
+    return profile;
+}
+
+void TickProfiler::EndTick(std::unique_ptr<TickProfile> profile) {
+    if (!profile) {
+        return;
+    }
+    profile->duration = Clock::now() - profile->start;
+    const auto tick = profile->tick;
+    std::atomic_store_explicit(&ring_[tick % ring_.size()], std::shared_ptr<const TickProfile>(std::move(profile)),
+                               std::memory_order_release);
+    tick_count_.store(tick + 1, std::memory_order_release);
+}
+
+std::vector<std::shared_ptr<const TickProfile>> TickProfiler::GetRecentTicks() const {
+    std::vector<std::shared_ptr<const TickProfile>> ticks;
+    const auto tick_count = tick_count_.load(std::memory_order_acquire);
+    const auto first_tick = tick_count > ring_.size() ? tick_count - ring_.size() : 0;
+    ticks.reserve(tick_count - first_tick);
+    for (auto tick = first_tick; tick < tick_count; ++tick) {
+        auto profile = std::atomic_load_explicit(&ring_[tick % ring_.size()], std::memory_order_acquire);
+        // Слот мог быть уже перезаписан более новым тиком
+        if (profile && profile->tick == tick) {
+            ticks.push_back(std::move(profile));
+        }
+    }
+    return ticks;
+}
+
+json::value TickProfiler::ToJson() const {
+    const auto ticks = GetRecentTicks();
+
+    DurationStats tick_stats;
+    PhaseStats phase_stats;
+    std::map<std::pair<std::string_view, std::size_t>, PhaseStats> session_stats;
+    json::array recent_ticks;
+    for (const auto& profile : ticks) {
+        tick_stats.Add(profile->duration);
+        // Этапы сессий в сводке тика - суммарное время по всем сессиям
+        PhaseTimes phases = profile->phases;
+        for (const auto& session : profile->sessions) {
+            auto& stats = session_stats[{session.map_id, session.session_index}];
+            for (std::size_t i = 0; i < PHASE_COUNT; ++i) {
+                phases[i] += session.phases[i];
+                stats[i].Add(session.phases[i]);
+            }
+        }
+        for (std::size_t i = 0; i < PHASE_COUNT; ++i) {
+            phase_stats[i].Add(phases[i]);
+        }
+        recent_ticks.emplace_back(json::object{
+            {"tick"sv, profile->tick},
+            {"durationUs"sv, ToMicroseconds(profile->duration)},
+            {"sessionCount"sv, profile->sessions.size()}
+        });
+    }
+
+    json::array sessions;
+    for (const auto& [session, stats] : session_stats) {
+        sessions.emplace_back(json::object{
+            {"mapId"sv, session.first},
+            {"session"sv, session.second},
+            {"phases"sv, PhaseStatsToJson(stats, Phase::BuildItems, Phase::PublishSnapshot)}
+        });
+    }
+
+    return json::object{
+        {"tickCount"sv, ticks.size()},
+        {"duration"sv, tick_stats.ToJson()},
+        {"phases"sv, PhaseStatsToJson(phase_stats, Phase::GroupSessions, Phase::PublishSnapshot)},
+        {"sessions"sv, std::move(sessions)},
+        {"ticks"sv, std::move(recent_ticks)}
+    };
+}
+
+std::string TickProfiler::ToFoldedStacks() const {
+    // Стек -> суммарное время
+    std::map<std::string, Clock::duration> stacks;
+    for (const auto& profile : GetRecentTicks()) {
+        auto self_time = profile->duration;
+        auto add = [&](std::string stack, Clock::duration duration) {
+            if (duration > Clock::duration::zero()) {
+                stacks[std::move(stack)] += duration;
+                self_time -= duration;
+            }
+        };
+        for (std::size_t i = 0; i < PHASE_COUNT; ++i) {
+            add("tick;"s + std::string(PHASE_NAMES[i]), profile->phases[i]);
+        }
+        for (const auto& session : profile->sessions) {
+            const auto session_frame = "tick;session "s + std::string(session.map_id) + "#"s + std::to_string(session.session_index) + ";"s;
+            for (std::size_t i = 0; i < PHASE_COUNT; ++i) {
+                add(session_frame + std::string(PHASE_NAMES[i]), session.phases[i]);
+            }
+        }
+        // Время тика вне измеряемых этапов (сессии обрабатываются параллельно, тогда их сумма больше тика)
+        if (self_time > Clock::duration::zero()) {
+            stacks["tick"s] += self_time;
+        }
+    }
+
+    std::ostringstream out;
+    for (const auto& [stack, duration] : stacks) {
+        const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        if (microseconds > 0) {
+            out << stack << ' ' << microseconds << '\n';
+        }
+    }
+    return out.str();
+}
+
+}  // namespace tick_profiler
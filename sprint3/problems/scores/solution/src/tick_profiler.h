@@ -0,0 +1,114 @@
+#pragma once
+
+#include <boost/json.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tick_profiler {
+
+namespace json = boost::json;
+
+// Этапы тика. Этапы сессий измеряются для каждой сессии отдельно
+enum class Phase {
+    // Этапы всего тика
+    GroupSessions,
+    GenerateLoot,
+    // Этапы сессии
+    BuildItems,
+    ComputeNextStates,
+    FindEvents,
+    ApplyEvents,
+    PublishSnapshot,
+
+    Count
+};
+
+inline constexpr std::size_t PHASE_COUNT = static_cast<std::size_t>(Phase::Count);
+inline constexpr std::array<std::string_view, PHASE_COUNT> PHASE_NAMES{
+    "groupSessions", "generateLoot", "buildItems", "computeNextStates", "findEvents", "applyEvents", "publishSnapshot"
+};
+
+using Clock = std::chrono::steady_clock;
+using PhaseTimes = std::array<Clock::duration, PHASE_COUNT>;
+
+// Добавляет время жизни объекта к длительности этапа. При phases == nullptr ничего не измеряет
+class ScopedTimer {
+public:
+    ScopedTimer(PhaseTimes* phases, Phase phase) noexcept
+        : phases_(phases)
+        , phase_(phase)
+        , start_(phases ? Clock::now() : Clock::time_point{}) {
+    }
+
+    ~ScopedTimer() {
+        if (phases_) {
+            (*phases_)[static_cast<std::size_t>(phase_)] += Clock::now() - start_;
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    PhaseTimes* phases_;
+    Phase phase_;
+    Clock::time_point start_;
+};
+
+struct SessionProfile {
+    // Идентификатор карты живёт столько же, сколько игра
+    std::string_view map_id;
+    // Номер сессии среди сессий карты
+    std::size_t session_index = 0;
+    PhaseTimes phases{};
+};
+
+struct TickProfile {
+    std::uint64_t tick = 0;
+    Clock::time_point start;
+    Clock::duration duration{};
+    // Этапы всего тика
+    PhaseTimes phases{};
+    // Этапы сессий. Во время тика каждый элемент заполняет только поток, обрабатывающий сессию
+    std::vector<SessionProfile> sessions;
+};
+
+/*
+ * Хранит профили последних depth тиков в кольцевом буфере.
+ * BeginTick/EndTick вызываются последовательно из потока, выполняющего тик,
+ * чтение профилей (ToJson, ToFoldedStacks) возможно из любых потоков без блокировки тика
+ */
+class TickProfiler {
+public:
+    // depth == 0 - профилирование выключено
+    explicit TickProfiler(std::size_t depth);
+
+    TickProfiler(const TickProfiler&) = delete;
+    TickProfiler& operator=(const TickProfiler&) = delete;
+
+    // Профиль нового тика или nullptr, если профилирование выключено
+    std::unique_ptr<TickProfile> BeginTick() const;
+    void EndTick(std::unique_ptr<TickProfile> profile);
+
+    // Сводка по сохранённым тикам: длительность тика и этапов (среднее и максимум), в том числе по сессиям
+    json::value ToJson() const;
+    // Суммарное время этапов сохранённых тиков (мкс) в формате "стек значение" для flamegraph.pl
+    std::string ToFoldedStacks() const;
+
+private:
+    // Сохранённые профили от старых к новым
+    std::vector<std::shared_ptr<const TickProfile>> GetRecentTicks() const;
+
+private:
+    std::vector<std::shared_ptr<const TickProfile>> ring_;
+    std::atomic<std::uint64_t> tick_count_{0};
+};
+
+}  // namespace tick_profiler
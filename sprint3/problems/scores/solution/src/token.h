@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace players {
+
+// Токен игрока: 128-битное значение, в API передаётся как 32 шестнадцатеричные цифры
+struct Token {
+    static constexpr std::size_t HEX_SIZE = 32;
+
+    std::uint64_t hi = 0;
+    std::uint64_t lo = 0;
+
+    // Разбор без ветвлений по символам: некорректные цифры накапливаются в маске и проверяются один раз
+    static constexpr std::optional<Token> FromString(std::string_view hex) noexcept {
+        if (hex.size() != HEX_SIZE) {
+            return std::nullopt;
+        }
+
+        Token token;
+        std::uint8_t invalid = 0;
+        for (std::size_t i = 0; i < HEX_SIZE / 2; ++i) {
+            const auto hi_digit = HEX_DIGITS[static_cast<unsigned char>(hex[i])];
+            const auto lo_digit = HEX_DIGITS[static_cast<unsigned char>(hex[i + HEX_SIZE / 2])];
+            invalid |= hi_digit | lo_digit;
+            token.hi = (token.hi << 4) | (hi_digit & 0xF);
+            token.lo = (token.lo << 4) | (lo_digit & 0xF);
+        }
+        if (invalid & INVALID_DIGIT) {
+            return std::nullopt;
+        }
+        return token;
+    }
+
+    // Строчные шестнадцатеричные цифры, по таблице пар цифр для каждого байта
+    constexpr std::array<char, HEX_SIZE> ToChars() const noexcept {
+        std::array<char, HEX_SIZE> chars{};
+        for (std::size_t i = 0; i < sizeof(std::uint64_t); ++i) {
+            const auto shift = 56 - 8 * i;
+            const auto hi_byte = static_cast<std::size_t>((hi >> shift) & 0xFF);
+            const auto lo_byte = static_cast<std::size_t>((lo >> shift) & 0xFF);
+            chars[2 * i] = HEX_PAIRS[2 * hi_byte];
+            chars[2 * i + 1] = HEX_PAIRS[2 * hi_byte + 1];
+            chars[HEX_SIZE / 2 + 2 * i] = HEX_PAIRS[2 * lo_byte];
+            chars[HEX_SIZE / 2 + 2 * i + 1] = HEX_PAIRS[2 * lo_byte + 1];
+        }
+        return chars;
+    }
+
+    std::string ToString() const {
+        const auto chars = ToChars();
+        return std::string(chars.data(), chars.size());
+    }
+
+    constexpr bool operator==(const Token&) const = default;
+
+private:
+    static constexpr std::uint8_t INVALID_DIGIT = 0x80;
+
+    static constexpr std::array<std::uint8_t, 256> HEX_DIGITS = [] {
+        std::array<std::uint8_t, 256> digits{};
+        digits.fill(INVALID_DIGIT);
+        for (int c = '0'; c <= '9'; ++c) {
+            digits[c] = static_cast<std::uint8_t>(c - '0');
+        }
+        for (int c = 'a'; c <= 'f'; ++c) {
+            digits[c] = static_cast<std::uint8_t>(c - 'a' + 10);
+            digits[c - 'a' + 'A'] = static_cast<std::uint8_t>(c - 'a' + 10);
+        }
+        return digits;
+    }();
+
+    static constexpr std::array<char, 512> HEX_PAIRS = [] {
+        constexpr std::string_view digits = "0123456789abcdef";
+        std::array<char, 512> pairs{};
+        for (std::size_t byte = 0; byte < 256; ++byte) {
+            pairs[2 * byte] = digits[byte >> 4];
+            pairs[2 * byte + 1] = digits[byte & 0xF];
+        }
+        return pairs;
+    }();
+};
+
+struct TokenHasher {
+    std::size_t operator()(const Token& token) const noexcept {
+        // Токены случайны, поэтому достаточно перемешать половины
+        return static_cast<std::size_t>(token.hi ^ (token.lo * 0x9E3779B97F4A7C15ull));
+    }
+};
+
+/*
+ * Случайный токен. Можно вызывать из любого потока: у каждого потока свой генератор,
+ * инициализированный из std::random_device при первом вызове в этом потоке
+ */
+inline Token GenerateToken() {
+    thread_local std::mt19937_64 generator = [] {
+        std::random_device random_device;
+        std::array<std::random_device::result_type, 8> seed_data;
+        for (auto& value : seed_data) {
+            value = random_device();
+        }
+        std::seed_seq seed(seed_data.begin(), seed_data.end());
+        return std::mt19937_64(seed);
+    }();
+    const auto hi = generator();
+    return Token{hi, generator()};
+}
+
+}  // namespace players
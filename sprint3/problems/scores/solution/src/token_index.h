@@ -0,0 +1,136 @@
+#pragma once
+
+#include "token.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace players {
+
+/*
+ * Индекс "токен -> значение" для частого чтения из любых потоков.
+ *
+ * Ключи разбиты по шардам, в каждом шарде - хеш-таблица с открытой адресацией.
+ * Добавления в шард сериализуются мьютексом шарда, чтение идёт без блокировок:
+ * значение слота публикуется последним (release), поэтому читатель, увидевший значение,
+ * видит и ключ. При росте таблица шарда копируется и подменяется атомарно, старые таблицы
+ * не освобождаются до разрушения индекса, так как их могут дочитывать другие потоки
+ * (из-за роста вдвое они занимают не больше памяти, чем текущие таблицы).
+ * Удаление ключей не поддерживается - игроки не покидают игру.
+ */
+template <typename Value>
+class TokenIndex {
+public:
+    TokenIndex() = default;
+
+    TokenIndex(const TokenIndex&) = delete;
+    TokenIndex& operator=(const TokenIndex&) = delete;
+
+    // Возвращает false, если такой ключ уже есть
+    bool Insert(const Token& key, Value* value) {
+        auto& shard = GetShard(key);
+        std::lock_guard lock{shard.write_mutex};
+
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        if (table && Find(*table, key)) {
+            return false;
+        }
+        if (!table || (shard.size + 1) * 2 > table->slots.size()) {
+            table = Grow(shard);
+        }
+        InsertSlot(*table, key, value);
+        ++shard.size;
+        return true;
+    }
+
+    Value* Find(const Token& key) const noexcept {
+        const Table* table = GetShard(key).table.load(std::memory_order_acquire);
+        return table ? Find(*table, key) : nullptr;
+    }
+
+private:
+    static constexpr size_t SHARD_COUNT = 64;
+    static constexpr size_t INITIAL_TABLE_SIZE = 16;
+
+    struct Slot {
+        std::atomic<std::uint64_t> hi{0};
+        std::atomic<std::uint64_t> lo{0};
+        std::atomic<Value*> value{nullptr};
+    };
+
+    struct Table {
+        explicit Table(size_t size)
+            : slots(size) {
+        }
+
+        // Размер - степень двойки
+        std::vector<Slot> slots;
+    };
+
+    struct alignas(64) Shard {
+        std::atomic<Table*> table{nullptr};
+        std::mutex write_mutex;
+        size_t size = 0;
+        std::vector<std::unique_ptr<Table>> tables;
+    };
+
+    static size_t Hash(const Token& key) noexcept {
+        return TokenHasher{}(key) >> 7;
+    }
+
+    Shard& GetShard(const Token& key) noexcept {
+        return shards_[(key.hi ^ key.lo) % SHARD_COUNT];
+    }
+    const Shard& GetShard(const Token& key) const noexcept {
+        return shards_[(key.hi ^ key.lo) % SHARD_COUNT];
+    }
+
+    static Value* Find(const Table& table, const Token& key) noexcept {
+        const size_t mask = table.slots.size() - 1;
+        for (size_t i = Hash(key) & mask;; i = (i + 1) & mask) {
+            const Slot& slot = table.slots[i];
+            Value* value = slot.value.load(std::memory_order_acquire);
+            if (!value) {
+                return nullptr;
+            }
+            if (slot.hi.load(std::memory_order_relaxed) == key.hi && slot.lo.load(std::memory_order_relaxed) == key.lo) {
+                return value;
+            }
+        }
+    }
+
+    static void InsertSlot(Table& table, const Token& key, Value* value) noexcept {
+        const size_t mask = table.slots.size() - 1;
+        size_t i = Hash(key) & mask;
+        while (table.slots[i].value.load(std::memory_order_relaxed)) {
+            i = (i + 1) & mask;
+        }
+        table.slots[i].hi.store(key.hi, std::memory_order_relaxed);
+        table.slots[i].lo.store(key.lo, std::memory_order_relaxed);
+        table.slots[i].value.store(value, std::memory_order_release);
+    }
+
+    static Table* Grow(Shard& shard) {
+        const Table* old_table = shard.table.load(std::memory_order_relaxed);
+        auto& new_table = shard.tables.emplace_back(
+            std::make_unique<Table>(old_table ? old_table->slots.size() * 2 : INITIAL_TABLE_SIZE));
+        if (old_table) {
+            for (const auto& slot : old_table->slots) {
+                if (Value* value = slot.value.load(std::memory_order_relaxed)) {
+                    InsertSlot(*new_table, Token{slot.hi.load(std::memory_order_relaxed),
+                                                    slot.lo.load(std::memory_order_relaxed)}, value);
+                }
+            }
+        }
+        shard.table.store(new_table.get(), std::memory_order_release);
+        return new_table.get();
+    }
+
+    std::array<Shard, SHARD_COUNT> shards_;
+};
+
+}  // namespace players
@@ -159,10 +159,12 @@ class GameState {
     this.cameraPos = undefined;
     this.lostObjects = {};
     this.abandonedLoot = []
+    this.streaming = false;
 
     this._updateState(function() {
       self.stateLoaded = true;
       self._startGame();
+      self._openStateStream();
     });
     this._syncPlayers(function() {
       self.playersLoaded = true;
@@ -178,7 +180,15 @@ class GameState {
     if (!this.started)
       return false;
 
-    if ((this.ticks % this.posUpdateInterval == 0 || this.requestInstantUpdate) && !this.updateInProgress) {
+    // Pending state pushed by the server replaces polling
+    if (this.streaming) {
+      if (this.streamedState !== undefined) {
+        this.desiredState = this.streamedState;
+        this.streamedState = undefined;
+        this._applyDesiredState();
+      }
+    }
+    else if ((this.ticks % this.posUpdateInterval == 0 || this.requestInstantUpdate) && !this.updateInProgress) {
       this.requestInstantUpdate = false;
       this._updateState(function() {
         self._applyDesiredState();
@@ -405,6 +415,27 @@ class GameState {
     })
   }
 
+  _openStateStream() {
+    if (!('WebSocket' in window)) {
+      return;
+    }
+
+    let self = this;
+    const protocol = window.location.protocol === 'https:' ? 'wss://' : 'ws://';
+    const socket = new WebSocket(protocol + window.location.host + '/api/v1/game/stream?token=' + Cookies.get('authToken'));
+    socket.onopen = function() {
+      self.streaming = true;
+    };
+    socket.onmessage = function(event) {
+      self.streamedState = JSON.parse(event.data);
+      self.stateTime = performance.now();
+    };
+    // Fall back to polling if the stream is unavailable
+    socket.onclose = function() {
+      self.streaming = false;
+    };
+  }
+
   _interpolateRotation(old_pos, new_pos) {
     const pi = Math.PI;
     const rot_speed = pi / 300;
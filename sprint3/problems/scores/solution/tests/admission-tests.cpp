@@ -0,0 +1,78 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../src/admission.h"
+
+using namespace admission;
+
+SCENARIO("Admission budget") {
+    GIVEN("a budget of two places") {
+        auto budget = std::make_shared<Budget>(2);
+
+        WHEN("all places are taken") {
+            auto first = budget->TryAcquire();
+            auto second = budget->TryAcquire();
+
+            THEN("requests over the limit are rejected and counted") {
+                CHECK(first);
+                CHECK(second);
+                CHECK(budget->GetInUse() == 2);
+                CHECK_FALSE(budget->TryAcquire());
+                CHECK(budget->GetRejectedCount() == 1);
+                CHECK(budget->GetInUse() == 2);
+            }
+        }
+        WHEN("a ticket is released") {
+            auto first = budget->TryAcquire();
+            auto second = budget->TryAcquire();
+            {
+                auto moved = std::move(first);
+                CHECK_FALSE(first);
+            }
+
+            THEN("its place can be taken again") {
+                CHECK(budget->GetInUse() == 1);
+                CHECK(budget->TryAcquire());
+                CHECK(budget->GetInUse() == 1);
+            }
+        }
+    }
+
+    GIVEN("a ticket that outlives the owner of its budget") {
+        auto budget = std::make_shared<Budget>(1);
+        std::weak_ptr<Budget> weak_budget = budget;
+        auto ticket = budget->TryAcquire();
+        budget.reset();
+
+        THEN("the budget lives until the ticket is released") {
+            REQUIRE_FALSE(weak_budget.expired());
+            CHECK(weak_budget.lock()->GetInUse() == 1);
+            ticket.Release();
+            CHECK(weak_budget.expired());
+        }
+    }
+
+    GIVEN("an unlimited budget used from several threads") {
+        auto budget = std::make_shared<Budget>(0);
+        {
+            std::vector<std::jthread> threads;
+            for (int i = 0; i < 4; ++i) {
+                threads.emplace_back([budget] {
+                    for (int j = 0; j < 10000; ++j) {
+                        auto ticket = budget->TryAcquire();
+                        CHECK(ticket);
+                    }
+                });
+            }
+        }
+
+        THEN("nothing is rejected and all places are released") {
+            CHECK(budget->GetRejectedCount() == 0);
+            CHECK(budget->GetInUse() == 0);
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "../src/api_router.h"
+
+using namespace std::literals;
+using http_handler::DecodedPath;
+using http_handler::Router;
+
+namespace {
+
+enum class TestRoute {
+    Join,
+    State,
+    Maps,
+    Map,
+    Metrics
+};
+
+struct TestRouteInfo {
+    std::string_view path;
+    bool has_param;
+    TestRoute route;
+};
+
+constexpr Router TEST_ROUTER{std::array{
+    TestRouteInfo{"/api/v1/game/join"sv, false, TestRoute::Join},
+    TestRouteInfo{"/api/v1/game/state"sv, false, TestRoute::State},
+    TestRouteInfo{"/api/v1/maps"sv, false, TestRoute::Maps},
+    TestRouteInfo{"/api/v1/maps/"sv, true, TestRoute::Map},
+    TestRouteInfo{"/api/v1/metrics"sv, false, TestRoute::Metrics}
+}};
+
+// Таблица строится на этапе компиляции, поэтому и искать в ней можно на этапе компиляции
+static_assert(TEST_ROUTER.Match("/api/v1/maps"sv)->route == TestRoute::Maps);
+static_assert(TEST_ROUTER.Match("/api/v1/unknown"sv) == nullptr);
+
+}  // namespace
+
+SCENARIO("API router") {
+    GIVEN("a route table with exact and parameterized routes") {
+        THEN("exact paths match their routes") {
+            for (const auto& [path, route] : {std::pair{"/api/v1/game/join"sv, TestRoute::Join},
+                                              std::pair{"/api/v1/game/state"sv, TestRoute::State},
+                                              std::pair{"/api/v1/maps"sv, TestRoute::Maps},
+                                              std::pair{"/api/v1/metrics"sv, TestRoute::Metrics}}) {
+                const auto* match = TEST_ROUTER.Match(path);
+                REQUIRE(match);
+                CHECK(match->route == route);
+                CHECK(TEST_ROUTER.GetParam(*match, path).empty());
+            }
+        }
+
+        THEN("the parameter is the rest of the path after the route prefix") {
+            const auto path = "/api/v1/maps/map1"sv;
+            const auto* match = TEST_ROUTER.Match(path);
+            REQUIRE(match);
+            CHECK(match->route == TestRoute::Map);
+            CHECK(TEST_ROUTER.GetParam(*match, path) == "map1"sv);
+            CHECK(TEST_ROUTER.GetParam(*match, "/api/v1/maps/a/b"sv) == "a/b"sv);
+        }
+
+        THEN("an empty parameter does not match the parameterized route") {
+            CHECK(TEST_ROUTER.Match("/api/v1/maps/"sv) == nullptr);
+        }
+
+        THEN("unknown paths do not match") {
+            CHECK(TEST_ROUTER.Match(""sv) == nullptr);
+            CHECK(TEST_ROUTER.Match("/"sv) == nullptr);
+            CHECK(TEST_ROUTER.Match("/api/v1/game"sv) == nullptr);
+            CHECK(TEST_ROUTER.Match("/api/v1/game/join/"sv) == nullptr);
+            CHECK(TEST_ROUTER.Match("/api/v1/MAPS"sv) == nullptr);
+            CHECK(TEST_ROUTER.Match("/api/v1/map"sv) == nullptr);
+        }
+    }
+}
+
+SCENARIO("Decoded request path") {
+    GIVEN("request targets") {
+        THEN("the path is decoded and the query is kept as is") {
+            const DecodedPath path{"/api/v1/maps/map%201?since=5&x=%41"sv};
+            REQUIRE(path.IsValid());
+            CHECK(path.View() == "/api/v1/maps/map 1"sv);
+            CHECK(path.Query() == "since=5&x=%41"sv);
+
+            const auto* match = TEST_ROUTER.Match(path.View());
+            REQUIRE(match);
+            CHECK(TEST_ROUTER.GetParam(*match, path.View()) == "map 1"sv);
+        }
+
+        THEN("a target without parameters has an empty query") {
+            const DecodedPath path{"/api/v1/game/state"sv};
+            REQUIRE(path.IsValid());
+            CHECK(path.View() == "/api/v1/game/state"sv);
+            CHECK(path.Query().empty());
+            CHECK(DecodedPath{"/api/v1/game/state?"sv}.Query().empty());
+        }
+
+        THEN("invalid %-encoding makes the path invalid") {
+            CHECK_FALSE(DecodedPath{"/api/v1/maps/%zz"sv}.IsValid());
+            CHECK_FALSE(DecodedPath{"/api/v1/maps/%4"sv}.IsValid());
+            CHECK_FALSE(DecodedPath{"/api/v1/maps/%"sv}.IsValid());
+            // %-кодирование в строке параметров проверяется при разборе параметров
+            CHECK(DecodedPath{"/api/v1/maps?x=%zz"sv}.IsValid());
+        }
+
+        THEN("paths longer than MAX_SIZE are invalid") {
+            const auto prefix = "/api/v1/maps/"s;
+            const auto longest = prefix + std::string(DecodedPath::MAX_SIZE - prefix.size(), 'a');
+            const DecodedPath longest_path{longest};
+            REQUIRE(longest_path.IsValid());
+            CHECK(longest_path.View() == longest);
+
+            CHECK_FALSE(DecodedPath{longest + "a"s}.IsValid());
+            // Ограничение касается декодированного пути, строка параметров в него не входит
+            CHECK(DecodedPath{longest + "?"s + std::string(1000, 'q')}.IsValid());
+            // Три символа %-кодирования дают один декодированный
+            CHECK(DecodedPath{prefix + std::string(DecodedPath::MAX_SIZE - prefix.size() - 1, 'a') + "%41"s}.IsValid());
+        }
+    }
+}
@@ -0,0 +1,236 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/async_log_sink.h"
+
+using namespace std::literals;
+using json_logger::AsyncLogSink;
+using json_logger::OverflowPolicy;
+
+namespace {
+
+// Временный файл, в который пишет AsyncLogSink
+class TempFile {
+public:
+    TempFile() {
+        std::string path_template = "/tmp/async-log-sink-tests-XXXXXX"s;
+        fd_ = ::mkstemp(path_template.data());
+        REQUIRE(fd_ >= 0);
+        path_ = std::move(path_template);
+    }
+
+    TempFile(const TempFile&) = delete;
+    TempFile& operator=(const TempFile&) = delete;
+
+    ~TempFile() {
+        ::close(fd_);
+        ::unlink(path_.c_str());
+    }
+
+    int GetFd() const noexcept {
+        return fd_;
+    }
+
+    std::vector<std::string> ReadLines() const {
+        std::ifstream file(path_);
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(file, line);) {
+            lines.push_back(std::move(line));
+        }
+        return lines;
+    }
+
+private:
+    int fd_ = -1;
+    std::string path_;
+};
+
+// Канал, читатель которого запускается отдельно: пока он не запущен, вывод в канал блокируется
+class Pipe {
+public:
+    Pipe() {
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        read_fd_ = fds[0];
+        write_fd_ = fds[1];
+    }
+
+    Pipe(const Pipe&) = delete;
+    Pipe& operator=(const Pipe&) = delete;
+
+    ~Pipe() {
+        if (reader_.joinable()) {
+            CloseWriteEnd();
+            reader_.join();
+        }
+        CloseWriteEnd();
+        ::close(read_fd_);
+    }
+
+    int GetWriteFd() const noexcept {
+        return write_fd_;
+    }
+
+    // Читает канал до закрытия пишущего конца
+    void StartReading() {
+        reader_ = std::thread([this] {
+            char buffer[4096];
+            for (ssize_t size; (size = ::read(read_fd_, buffer, sizeof(buffer))) > 0;) {
+                data_.append(buffer, static_cast<std::size_t>(size));
+            }
+        });
+    }
+
+    std::string FinishReading() {
+        CloseWriteEnd();
+        reader_.join();
+        return std::move(data_);
+    }
+
+private:
+    void CloseWriteEnd() {
+        if (write_fd_ >= 0) {
+            ::close(write_fd_);
+            write_fd_ = -1;
+        }
+    }
+
+    int read_fd_ = -1;
+    int write_fd_ = -1;
+    std::thread reader_;
+    std::string data_;
+};
+
+std::string MakeRecord(std::size_t producer, std::size_t index) {
+    return std::to_string(producer) + " "s + std::to_string(index) + "\n"s;
+}
+
+// Проверяет, что записи каждого производителя выведены полностью и по порядку
+void CheckProducerOrder(const std::vector<std::string>& lines, std::size_t producer_count, std::size_t record_count) {
+    std::vector<std::size_t> next_index(producer_count, 0);
+    for (const auto& line : lines) {
+        std::istringstream input(line);
+        std::size_t producer = 0, index = 0;
+        input >> producer >> index;
+        REQUIRE(input);
+        REQUIRE(producer < producer_count);
+        REQUIRE(index == next_index[producer]);
+        ++next_index[producer];
+    }
+    for (std::size_t producer = 0; producer < producer_count; ++producer) {
+        CHECK(next_index[producer] == record_count);
+    }
+}
+
+}  // namespace
+
+SCENARIO("Asynchronous log sink") {
+    constexpr std::size_t PRODUCER_COUNT = 4;
+    constexpr std::size_t RECORD_COUNT = 20000;
+
+    GIVEN("several producers writing to a file") {
+        TempFile file;
+
+        WHEN("the queue is much smaller than the number of records and the overflow policy is Block") {
+            {
+                AsyncLogSink sink{file.GetFd(), AsyncLogSink::Options{4, OverflowPolicy::Block}};
+                std::vector<std::thread> producers;
+                for (std::size_t producer = 0; producer < PRODUCER_COUNT; ++producer) {
+                    producers.emplace_back([&sink, producer] {
+                        for (std::size_t index = 0; index < RECORD_COUNT; ++index) {
+                            sink.Push(MakeRecord(producer, index));
+                        }
+                    });
+                }
+                // Писатели ждут освобождения места в очереди, но не блокируют друг друга навсегда
+                for (auto& producer : producers) {
+                    producer.join();
+                }
+                sink.Stop();
+                CHECK(sink.GetDroppedCount() == 0);
+            }
+
+            THEN("no record is lost or reordered within a producer") {
+                const auto lines = file.ReadLines();
+                CHECK(lines.size() == PRODUCER_COUNT * RECORD_COUNT);
+                CheckProducerOrder(lines, PRODUCER_COUNT, RECORD_COUNT);
+            }
+        }
+
+        WHEN("the sink is stopped right after the records are queued") {
+            constexpr std::size_t QUEUED_COUNT = 1000;
+            AsyncLogSink sink{file.GetFd(), AsyncLogSink::Options{QUEUED_COUNT, OverflowPolicy::Drop}};
+            for (std::size_t index = 0; index < QUEUED_COUNT; ++index) {
+                REQUIRE(sink.Push(MakeRecord(0, index)));
+            }
+            sink.Stop();
+
+            THEN("all queued records are written") {
+                const auto lines = file.ReadLines();
+                CHECK(lines.size() == QUEUED_COUNT);
+                CheckProducerOrder(lines, 1, QUEUED_COUNT);
+                CHECK(sink.GetDroppedCount() == 0);
+            }
+        }
+    }
+
+    GIVEN("a sink writing to a pipe nobody reads yet") {
+        Pipe pipe;
+        // Запись больше буфера канала: вывод первой же пачки блокирует фоновый поток
+        const auto large_record = std::string(256 * 1024, 'x') + "\n"s;
+        constexpr std::size_t QUEUE_SIZE = 8;
+
+        WHEN("more records are pushed than fit into the queue with the Drop policy") {
+            constexpr std::size_t PUSH_COUNT = 100;
+            AsyncLogSink sink{pipe.GetWriteFd(), AsyncLogSink::Options{QUEUE_SIZE, OverflowPolicy::Drop}};
+            std::size_t accepted_count = 0;
+            for (std::size_t index = 0; index < PUSH_COUNT; ++index) {
+                accepted_count += sink.Push(large_record) ? 1 : 0;
+            }
+
+            THEN("records that did not fit are dropped and counted") {
+                CHECK(accepted_count <= QUEUE_SIZE);
+                CHECK(sink.GetDroppedCount() == PUSH_COUNT - accepted_count);
+
+                // Остановка выводит все принятые записи
+                pipe.StartReading();
+                sink.Stop();
+                const auto output = pipe.FinishReading();
+                CHECK(output.size() == accepted_count * large_record.size());
+                CHECK(sink.GetDroppedCount() == PUSH_COUNT - accepted_count);
+            }
+        }
+
+        WHEN("producers fill the queue with the Block policy") {
+            constexpr std::size_t PUSH_COUNT = 3 * QUEUE_SIZE;
+            AsyncLogSink sink{pipe.GetWriteFd(), AsyncLogSink::Options{QUEUE_SIZE, OverflowPolicy::Block}};
+            std::vector<std::thread> producers;
+            for (std::size_t producer = 0; producer < 2; ++producer) {
+                producers.emplace_back([&sink, &large_record] {
+                    for (std::size_t index = 0; index < PUSH_COUNT; ++index) {
+                        sink.Push(large_record);
+                    }
+                });
+            }
+
+            THEN("they continue once the output is drained and nothing is dropped") {
+                pipe.StartReading();
+                for (auto& producer : producers) {
+                    producer.join();
+                }
+                sink.Stop();
+                const auto output = pipe.FinishReading();
+                CHECK(output.size() == 2 * PUSH_COUNT * large_record.size());
+                CHECK(sink.GetDroppedCount() == 0);
+            }
+        }
+    }
+}
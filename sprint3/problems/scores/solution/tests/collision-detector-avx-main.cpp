@@ -0,0 +1,16 @@
+#include <catch2/catch_session.hpp>
+
+#include <iostream>
+
+// Код возврата, который CTest считает пропуском теста (SKIP_RETURN_CODE)
+constexpr int SKIP_RETURN_CODE = 77;
+
+// С -mavx собран только детектор столкновений, поэтому поддержку AVX процессором
+// можно проверить до первого вызова детектора
+int main(int argc, char* argv[]) {
+    if (!__builtin_cpu_supports("avx")) {
+        std::cerr << "CPU does not support AVX, collision detector AVX tests are skipped" << std::endl;
+        return SKIP_RETURN_CODE;
+    }
+    return Catch::Session().run(argc, argv);
+}
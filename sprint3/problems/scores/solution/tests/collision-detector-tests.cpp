@@ -1,9 +1,13 @@
 #define _USE_MATH_DEFINES
 
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_templated.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <random>
 #include <sstream>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "../src/collision_detector.h"
@@ -213,3 +217,136 @@ SCENARIO("Check existing events with one gatherer on X coordinate") {
         }
     }
 }
+
+namespace {
+
+// Полный перебор пар собиратель-предмет через виртуальные вызовы провайдера - исходная реализация
+// FindGatherEvents до появления широкой фазы (одновременные события упорядочены устойчиво)
+std::vector<GatheringEvent> FindGatherEventsBruteForce(const ItemGathererProvider& provider) {
+    std::vector<GatheringEvent> events;
+    for (size_t g = 0; g < provider.GatherersCount(); ++g) {
+        Gatherer gatherer = provider.GetGatherer(g);
+        if (gatherer.start_pos == gatherer.end_pos) {
+            continue;
+        }
+        for (size_t i = 0; i < provider.ItemsCount(); ++i) {
+            Item item = provider.GetItem(i);
+            auto collect_result = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
+            if (collect_result.IsCollected(gatherer.width + item.width)) {
+                events.push_back(GatheringEvent{i, g, collect_result.sq_distance, collect_result.proj_ratio});
+            }
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
+        return e_l.time < e_r.time;
+    });
+    return events;
+}
+
+ItemGathererProviderTest MakeRandomProvider(std::mt19937& rand_engine, size_t gatherer_count, size_t item_count, 
+                                            double map_size, double max_step, double max_item_width) {
+    std::uniform_real_distribution<double> coord(0.0, map_size);
+    std::uniform_real_distribution<double> step(-max_step, max_step);
+    std::uniform_real_distribution<double> item_width(0.0, max_item_width);
+
+    std::vector<Gatherer> gatherers;
+    gatherers.reserve(gatherer_count);
+    for (size_t i = 0; i < gatherer_count; ++i) {
+        Point2D start{coord(rand_engine), coord(rand_engine)};
+        Point2D end = (i % 2) ? Point2D{start.x + step(rand_engine), start.y} 
+                              : Point2D{start.x, start.y + step(rand_engine)};
+        gatherers.emplace_back(Gatherer{start, end, 0.6});
+    }
+
+    std::vector<Item> items;
+    items.reserve(item_count);
+    for (size_t i = 0; i < item_count; ++i) {
+        items.emplace_back(Item{{coord(rand_engine), coord(rand_engine)}, item_width(rand_engine)});
+    }
+    return ItemGathererProviderTest{std::move(gatherers), std::move(items)};
+}
+
+}  // namespace
+
+SCENARIO("Check events are the same as found by brute force") {
+    std::mt19937 rand_engine(42);
+
+    GIVEN("random gatherers and items") {
+        THEN("events and their order are the same") {
+            for (int i = 0; i < 100; ++i) {
+                auto provider = MakeRandomProvider(rand_engine, 30, 300, 40.0, 10.0, 1.0);
+                CHECK_THAT(FindGatherEvents(provider), AreEventsEqual(FindGatherEventsBruteForce(provider)));
+            }
+        }
+    }
+    GIVEN("random gatherers and items passed as spans") {
+        THEN("events are the same as for provider") {
+            for (int i = 0; i < 20; ++i) {
+                auto provider = MakeRandomProvider(rand_engine, 10, 500, 20.0, 10.0, 1.0);
+                std::vector<double> item_xs, item_ys, item_widths;
+                for (size_t j = 0; j < provider.ItemsCount(); ++j) {
+                    item_xs.push_back(provider.GetItem(j).position.x);
+                    item_ys.push_back(provider.GetItem(j).position.y);
+                    item_widths.push_back(provider.GetItem(j).width);
+                }
+                std::vector<double> start_xs, start_ys, end_xs, end_ys, gatherer_widths;
+                for (size_t j = 0; j < provider.GatherersCount(); ++j) {
+                    start_xs.push_back(provider.GetGatherer(j).start_pos.x);
+                    start_ys.push_back(provider.GetGatherer(j).start_pos.y);
+                    end_xs.push_back(provider.GetGatherer(j).end_pos.x);
+                    end_ys.push_back(provider.GetGatherer(j).end_pos.y);
+                    gatherer_widths.push_back(provider.GetGatherer(j).width);
+                }
+                auto events = FindGatherEvents(ItemSpans{item_xs, item_ys, item_widths},
+                                               GathererSpans{start_xs, start_ys, end_xs, end_ys, gatherer_widths});
+                CHECK_THAT(events, AreEventsEqual(FindGatherEventsBruteForce(provider)));
+            }
+        }
+    }
+    GIVEN("all items in one point") {
+        ItemGathererProviderTest provider{{{{-1.0, 0.0}, {1.0, 0.0}, 0.6}, {{0.0, 1.0}, {0.0, -1.0}, 0.6}},
+                                          std::vector<Item>(10, Item{{0.0, 0.0}, 0.0})};
+        THEN("events and their order are the same") {
+            CHECK_THAT(FindGatherEvents(provider), AreEventsEqual(FindGatherEventsBruteForce(provider)));
+        }
+    }
+}
+
+#ifdef __AVX__
+constexpr std::string_view KERNEL = "AVX"sv;
+#else
+constexpr std::string_view KERNEL = "scalar"sv;
+#endif
+
+// Ядро проверки зависит от сборки: цель collision_detector_avx_tests собирает те же тесты с -mavx
+TEST_CASE("Find gather events benchmark", "[.][benchmark]") {
+    std::mt19937 rand_engine(42);
+    auto provider = MakeRandomProvider(rand_engine, 1'000, 10'000, 1'000.0, 1.0, 0.5);
+
+    std::vector<double> item_xs, item_ys, item_widths;
+    for (size_t i = 0; i < provider.ItemsCount(); ++i) {
+        item_xs.push_back(provider.GetItem(i).position.x);
+        item_ys.push_back(provider.GetItem(i).position.y);
+        item_widths.push_back(provider.GetItem(i).width);
+    }
+    std::vector<double> start_xs, start_ys, end_xs, end_ys, gatherer_widths;
+    for (size_t g = 0; g < provider.GatherersCount(); ++g) {
+        start_xs.push_back(provider.GetGatherer(g).start_pos.x);
+        start_ys.push_back(provider.GetGatherer(g).start_pos.y);
+        end_xs.push_back(provider.GetGatherer(g).end_pos.x);
+        end_ys.push_back(provider.GetGatherer(g).end_pos.y);
+        gatherer_widths.push_back(provider.GetGatherer(g).width);
+    }
+
+    const auto kernel = std::string(KERNEL);
+    BENCHMARK("Baseline (provider, brute force): 1k gatherers, 10k items") {
+        return FindGatherEventsBruteForce(provider);
+    };
+    BENCHMARK("Provider copied to spans, grid, " + kernel + " kernel: 1k gatherers, 10k items") {
+        return FindGatherEvents(provider);
+    };
+    BENCHMARK("Spans, grid, " + kernel + " kernel: 1k gatherers, 10k items") {
+        return FindGatherEvents(ItemSpans{item_xs, item_ys, item_widths},
+                                GathererSpans{start_xs, start_ys, end_xs, end_ys, gatherer_widths});
+    };
+}
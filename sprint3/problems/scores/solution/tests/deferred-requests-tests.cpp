@@ -0,0 +1,114 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/deferred_requests.h"
+
+using namespace std::literals;
+using http_server::DeferredRequests;
+
+namespace net = boost::asio;
+
+SCENARIO("Requests of a connection deferred to the API strand") {
+    net::io_context ioc;
+    auto api_strand = net::make_strand(ioc);
+    auto connection_requests = std::make_shared<DeferredRequests>();
+
+    // Состояние игры, которое изменяют запросы в strand-е и читают запросы вне strand-а
+    int dog_speed = 0;
+    std::vector<std::string> responses;
+
+    auto pipelined_action = [&](DeferredRequests& requests) {
+        requests.Defer(api_strand, [&] {
+            dog_speed = 4;
+            responses.push_back("action"s);
+        });
+    };
+    auto pipelined_state = [&](DeferredRequests& requests) {
+        requests.RunInOrder(api_strand, [&] {
+            responses.push_back("state speed="s + std::to_string(dog_speed));
+        });
+    };
+
+    GIVEN("a connection without deferred requests") {
+        CHECK(connection_requests->IsEmpty());
+
+        WHEN("a state request arrives") {
+            pipelined_state(*connection_requests);
+
+            THEN("it is handled immediately") {
+                CHECK(responses == std::vector{"state speed=0"s});
+                CHECK(ioc.run() == 0);
+            }
+        }
+    }
+
+    GIVEN("a pipelined action waiting for the API strand") {
+        pipelined_action(*connection_requests);
+        CHECK_FALSE(connection_requests->IsEmpty());
+
+        WHEN("a state request of the same connection follows it") {
+            pipelined_state(*connection_requests);
+
+            THEN("the state request waits for the action and sees its result") {
+                CHECK(responses.empty());
+                ioc.run();
+                CHECK(responses == std::vector{"action"s, "state speed=4"s});
+                CHECK(connection_requests->IsEmpty());
+            }
+        }
+
+        WHEN("a state request of another connection arrives") {
+            auto other_connection_requests = std::make_shared<DeferredRequests>();
+            pipelined_state(*other_connection_requests);
+
+            THEN("it is not delayed by requests of the first connection") {
+                CHECK(responses == std::vector{"state speed=0"s});
+                ioc.run();
+                CHECK(responses == std::vector{"state speed=0"s, "action"s});
+            }
+        }
+
+        WHEN("the action has been handled") {
+            ioc.run();
+            ioc.restart();
+            REQUIRE(connection_requests->IsEmpty());
+            pipelined_state(*connection_requests);
+
+            THEN("later state requests are handled immediately again") {
+                CHECK(responses == std::vector{"action"s, "state speed=4"s});
+                CHECK(ioc.run() == 0);
+            }
+        }
+    }
+
+    GIVEN("several pipelined requests of one connection") {
+        pipelined_state(*connection_requests);
+        pipelined_action(*connection_requests);
+        pipelined_state(*connection_requests);
+        pipelined_state(*connection_requests);
+
+        THEN("they are handled in the order they were read") {
+            ioc.run();
+            CHECK(responses == std::vector{"state speed=0"s, "action"s, "state speed=4"s, "state speed=4"s});
+            CHECK(connection_requests->IsEmpty());
+        }
+    }
+
+    GIVEN("a deferred request that is never run") {
+        {
+            net::io_context stopped_ioc;
+            connection_requests->Defer(net::make_strand(stopped_ioc), [] {});
+            CHECK_FALSE(connection_requests->IsEmpty());
+        }
+
+        THEN("its mark is released with the handler") {
+            CHECK(connection_requests->IsEmpty());
+        }
+    }
+}
@@ -0,0 +1,179 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "../src/admission.h"
+#include "../src/http_server.h"
+
+using namespace std::literals;
+
+namespace {
+
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+using tcp = net::ip::tcp;
+
+// Тело ответа заведомо больше буферов сокетов: пока клиент его не читает, отправка не завершается
+constexpr std::size_t LARGE_BODY_SIZE = 64 * 1024 * 1024;
+
+// Отдаёт ответы, занимая место в бюджете до окончания их отправки (как запросы статических файлов)
+class BudgetedHandler {
+public:
+    explicit BudgetedHandler(std::shared_ptr<admission::Budget> budget)
+        : budget_(std::move(budget)) {
+    }
+
+    template <typename Request, typename Send>
+    void operator()(Request&& request, Send&& send) {
+        http::response<http::string_body> response{http::status::ok, request.version()};
+        response.keep_alive(request.keep_alive());
+        auto ticket = budget_->TryAcquire();
+        if (!ticket) {
+            response.result(http::status::service_unavailable);
+        } else if (request.target() == "/large"sv) {
+            response.body().assign(LARGE_BODY_SIZE, 'x');
+        } else {
+            response.body() = "small"s;
+        }
+        response.prepare_payload();
+        send(std::move(response), std::move(ticket));
+    }
+
+    template <typename Request>
+    void operator()(Request&&, http_server::WebSocketUpgrade&&) {
+    }
+
+private:
+    std::shared_ptr<admission::Budget> budget_;
+};
+
+class Client {
+public:
+    explicit Client(const tcp::endpoint& endpoint)
+        : socket_(ioc_) {
+        socket_.connect(endpoint);
+    }
+
+    void SendRequest(std::string_view target) {
+        http::request<http::empty_body> request{http::verb::get, target, 11};
+        http::write(socket_, request);
+    }
+
+    http::response<http::string_body> ReadResponse() {
+        http::response_parser<http::string_body> parser;
+        parser.body_limit(LARGE_BODY_SIZE + 1);
+        http::read(socket_, buffer_, parser);
+        return parser.release();
+    }
+
+private:
+    net::io_context ioc_;
+    tcp::socket socket_;
+    boost::beast::flat_buffer buffer_;
+};
+
+// Ждёт выполнения условия не дольше нескольких секунд
+template <typename Predicate>
+bool WaitFor(Predicate predicate) {
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+// Обрабатывает асинхронные операции сервера в отдельном потоке, пока не будет разрушен
+class ServerThread {
+public:
+    explicit ServerThread(net::io_context& ioc)
+        : ioc_(ioc)
+        , thread_([&ioc] {
+            ioc.run();
+        }) {
+    }
+
+    ServerThread(const ServerThread&) = delete;
+    ServerThread& operator=(const ServerThread&) = delete;
+
+    ~ServerThread() {
+        ioc_.stop();
+        thread_.join();
+    }
+
+private:
+    net::io_context& ioc_;
+    std::thread thread_;
+};
+
+tcp::endpoint GetFreeEndpoint() {
+    net::io_context ioc;
+    tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+    return acceptor.local_endpoint();
+}
+
+}  // namespace
+
+SCENARIO("Response attachments live until the response is written") {
+    GIVEN("a server whose responses hold a place in a budget of one request") {
+        auto budget = std::make_shared<admission::Budget>(1);
+        net::io_context ioc;
+        const auto endpoint = GetFreeEndpoint();
+        http_server::ServeHttp(ioc, endpoint, BudgetedHandler{budget});
+        ServerThread server{ioc};
+
+        WHEN("a client requests a large response and does not read it yet") {
+            Client slow_client{endpoint};
+            slow_client.SendRequest("/large"sv);
+            REQUIRE(WaitFor([&budget] { return budget->GetInUse() == 1; }));
+
+            THEN("the place stays taken while the response is being written") {
+                std::this_thread::sleep_for(100ms);
+                CHECK(budget->GetInUse() == 1);
+
+                Client other_client{endpoint};
+                other_client.SendRequest("/small"sv);
+                CHECK(other_client.ReadResponse().result() == http::status::service_unavailable);
+                CHECK(budget->GetRejectedCount() == 1);
+
+                AND_THEN("the place is released once the response is written") {
+                    const auto response = slow_client.ReadResponse();
+                    CHECK(response.result() == http::status::ok);
+                    CHECK(response.body().size() == LARGE_BODY_SIZE);
+                    REQUIRE(WaitFor([&budget] { return budget->GetInUse() == 0; }));
+
+                    other_client.SendRequest("/small"sv);
+                    const auto small_response = other_client.ReadResponse();
+                    CHECK(small_response.result() == http::status::ok);
+                    CHECK(small_response.body() == "small"s);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Request targets are logged without player tokens") {
+    using http_server::RedactTarget;
+
+    GIVEN("targets without a token") {
+        THEN("they are logged as is") {
+            CHECK(RedactTarget("/api/v1/maps"sv) == "/api/v1/maps"s);
+            CHECK(RedactTarget("/api/v1/game/state?since=5"sv) == "/api/v1/game/state?since=5"s);
+            CHECK(RedactTarget("/api/v1/game/state?tokenize=1"sv) == "/api/v1/game/state?tokenize=1"s);
+        }
+    }
+
+    GIVEN("targets with a token") {
+        THEN("only the token value is replaced") {
+            CHECK(RedactTarget("/api/v1/game/state?token=0123456789abcdef"sv) == "/api/v1/game/state?token=***"s);
+            CHECK(RedactTarget("/api/v1/game/state?since=5&token=0123456789abcdef&x=1"sv)
+                  == "/api/v1/game/state?since=5&token=***&x=1"s);
+            CHECK(RedactTarget("/api/v1/game/state?%74oken=0123456789abcdef"sv) == "/api/v1/game/state?%74oken=***"s);
+        }
+    }
+}
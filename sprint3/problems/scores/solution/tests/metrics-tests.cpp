@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/metrics.h"
+
+using namespace std::literals;
+using namespace metrics;
+
+SCENARIO("Latency histogram buckets") {
+    GIVEN("values of different magnitude") {
+        THEN("every value is not above its bucket upper bound and above the previous bound") {
+            for (std::uint64_t value : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 1000ull, 123'456'789ull, ~0ull}) {
+                const auto index = LatencyHistogram::GetBucketIndex(value);
+                CHECK(index < LatencyHistogram::BUCKET_COUNT);
+                CHECK(value <= LatencyHistogram::GetBucketUpperBound(index));
+                if (index > 0) {
+                    CHECK(value > LatencyHistogram::GetBucketUpperBound(index - 1));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Latency histogram quantiles") {
+    GIVEN("a histogram with values from 1 to 1000 microseconds") {
+        LatencyHistogram histogram;
+        for (std::uint64_t i = 1; i <= 1000; ++i) {
+            histogram.Record(i * 1000);
+        }
+        LatencyHistogram::Snapshot snapshot;
+        histogram.AddTo(snapshot);
+
+        THEN("quantiles are within the bucket precision") {
+            CHECK(snapshot.count == 1000);
+            const auto median = snapshot.GetValueAtQuantile(0.5);
+            CHECK(median >= 500'000);
+            CHECK(median <= 500'000 + 500'000 / 8);
+            const auto p99 = snapshot.GetValueAtQuantile(0.99);
+            CHECK(p99 >= 990'000);
+            CHECK(p99 <= 990'000 + 990'000 / 8);
+        }
+        THEN("count not above the maximum value includes all values") {
+            CHECK(snapshot.GetCountNotAbove(~0ull) == 1000);
+            CHECK(snapshot.GetCountNotAbove(0) == 0);
+        }
+    }
+}
+
+SCENARIO("Request metrics") {
+    GIVEN("requests recorded from several threads") {
+        RequestMetrics metrics({"/api/v1/maps"s, "static"s});
+        {
+            std::vector<std::jthread> threads;
+            for (int i = 0; i < 4; ++i) {
+                threads.emplace_back([&metrics] {
+                    for (int j = 0; j < 1000; ++j) {
+                        metrics.RecordRequest(0, 200, 1ms, 10, 100);
+                    }
+                    metrics.RecordRequest(1, 404, 2ms, 0, 5);
+                });
+            }
+        }
+
+        THEN("metrics are summed over threads") {
+            const auto text = metrics.FormatPrometheus({{"open_connections"sv, 3}}, {{"rejected_requests"sv, 7}});
+            CHECK(text.find("game_server_request_duration_seconds_count{endpoint=\"/api/v1/maps\",code=\"200\"} 4000\n"s) != std::string::npos);
+            CHECK(text.find("game_server_request_duration_seconds_count{endpoint=\"static\",code=\"404\"} 4\n"s) != std::string::npos);
+            CHECK(text.find("game_server_request_body_bytes_total{endpoint=\"/api/v1/maps\"} 40000\n"s) != std::string::npos);
+            CHECK(text.find("game_server_response_body_bytes_total{endpoint=\"static\"} 20\n"s) != std::string::npos);
+            CHECK(text.find("# TYPE open_connections gauge\nopen_connections 3\n"s) != std::string::npos);
+            CHECK(text.find("# TYPE rejected_requests_total counter\nrejected_requests_total 7\n"s) != std::string::npos);
+            CHECK(text.find("rejected_requests "s) == std::string::npos);
+        }
+    }
+}
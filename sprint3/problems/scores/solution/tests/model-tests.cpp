@@ -1,6 +1,7 @@
 #include <cmath>
 #include <catch2/catch_test_macros.hpp>
 
+#include <random>
 #include <unordered_set>
 
 #include "../src/loot_generator.h"
@@ -55,5 +56,350 @@ SCENARIO("Loot objects generation in game session") {
                 REQUIRE(generated_lost_object_types.size() > 5);
             }
         }
+
+        WHEN("lost objects are removed") {
+            game_session->GenerateLostObjects(10, 3);
+            std::vector<GameSession::LostObject> lost_objects = game_session->GetLostObjects();
+            REQUIRE(game_session->RemoveLostObject(lost_objects.at(0).id));
+            REQUIRE(game_session->RemoveLostObject(lost_objects.at(5).id));
+            REQUIRE(game_session->RemoveLostObject(lost_objects.at(9).id));
+
+            THEN("other lost objects keep their ids and data") {
+                CHECK_FALSE(game_session->RemoveLostObject(lost_objects.at(5).id));
+                CHECK(game_session->GetLostObjects().size() == 7);
+                CHECK(game_session->FindLostObject(lost_objects.at(0).id) == nullptr);
+                for (size_t i : {1, 2, 3, 4, 6, 7, 8}) {
+                    const auto* lost_object = game_session->FindLostObject(lost_objects.at(i).id);
+                    REQUIRE(lost_object != nullptr);
+                    CHECK(lost_object->type == lost_objects.at(i).type);
+                    CHECK(lost_object->position.x == lost_objects.at(i).position.x);
+                    CHECK(lost_object->position.y == lost_objects.at(i).position.y);
+                }
+            }
+            THEN("new lost objects get new ids") {
+                game_session->GenerateLostObjects(1, 3);
+                CHECK(game_session->GetLostObjects().back().id == 10);
+            }
+        }
+    }
+}
+
+SCENARIO("Dogs storage in game session") {
+    Map map{Map::Id{"map1"s}, "Map 1"s, 4.0, 2};
+    map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, Coord{40}});
+
+    GIVEN("a game session with many dogs") {
+        GameSession game_session{&map};
+        auto first_dog = game_session.CreateDog("first"s);
+        for (int i = 0; i < 1000; ++i) {
+            game_session.CreateDog("dog"s + std::to_string(i));
+        }
+        auto last_dog = game_session.GetDogs().back();
+
+        THEN("dog handles stay valid after storage growth") {
+            REQUIRE(game_session.GetDogCount() == 1001);
+            CHECK(first_dog.GetId() == 0);
+            CHECK(first_dog.GetName() == "first"s);
+            CHECK(last_dog.GetId() == 1000);
+            CHECK(last_dog.GetName() == "dog999"s);
+        }
+
+        WHEN("dog state is changed through handle") {
+            first_dog.SetPosition(PointD{10.0, 0.2});
+            first_dog.SetSpeed(Dog::Speed{4.0, 0.0});
+            first_dog.SetDirection(Direction::EAST);
+
+            THEN("session arrays are updated only for this dog") {
+                CHECK(game_session.GetDogPositions()[0].x == 10.0);
+                CHECK(game_session.GetDogSpeeds()[0].x == 4.0);
+                CHECK(game_session.GetDogDirections()[0] == Direction::EAST);
+                CHECK(last_dog.GetSpeed().x == 0.0);
+                CHECK(last_dog.GetDirection() == Direction::NORTH);
+            }
+        }
+
+        WHEN("items are added in dog bag") {
+            REQUIRE(first_dog.AddItemInBag(Dog::BagItem{1, 2}));
+            REQUIRE(first_dog.AddItemInBag(Dog::BagItem{3, 4}));
+
+            THEN("bag capacity is limited by map and other bags are not touched") {
+                CHECK_FALSE(first_dog.AddItemInBag(Dog::BagItem{5, 6}));
+                CHECK(first_dog.GetBagItems().size() == 2);
+                CHECK(first_dog.GetBagItems().at(1).id == 3);
+                CHECK(game_session.GetDogs().at(1).GetBagItems().empty());
+                CHECK(first_dog.ClearBag() == 2);
+                CHECK(first_dog.GetBagItems().empty());
+            }
+        }
+    }
+}
+
+SCENARIO("Dogs movement in game session") {
+    // Дороги в форме буквы Г: по горизонтали от (0, 0) до (10, 0), по вертикали от (10, 0) до (10, 5)
+    Map map{Map::Id{"map1"s}, "Map 1"s, 1.0, Game::DEFAULT_BAG_CAPACITY};
+    map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, Coord{10}});
+    map.AddRoad(Road{Road::VERTICAL, Point{10, 0}, Coord{5}});
+    map.BuildRoadCorridors();
+
+    GIVEN("a game session with moving and standing dogs") {
+        GameSession game_session{&map};
+        auto east_dog = game_session.CreateDog("east"s);
+        east_dog.SetDirection(Direction::EAST);
+        east_dog.SetSpeed(Dog::Speed{2.0, 0.0});
+        auto north_dog = game_session.CreateDog("north"s);
+        north_dog.SetPosition(PointD{10.0, 4.0});
+        north_dog.SetDirection(Direction::NORTH);
+        north_dog.SetSpeed(Dog::Speed{0.0, -1.0});
+        auto standing_dog = game_session.CreateDog("standing"s);
+        standing_dog.SetPosition(PointD{3.0, 0.0});
+
+        WHEN("dogs move within roads") {
+            const auto paths = game_session.MoveDogs(1.5);
+
+            THEN("positions are changed by speed and dogs keep moving") {
+                CHECK(east_dog.GetPosition().x == 3.0);
+                CHECK(east_dog.GetPosition().y == 0.0);
+                CHECK(east_dog.GetSpeed().x == 2.0);
+                CHECK(north_dog.GetPosition().x == 10.0);
+                CHECK(north_dog.GetPosition().y == 2.5);
+                CHECK(north_dog.GetSpeed().y == -1.0);
+                CHECK(standing_dog.GetPosition().x == 3.0);
+            }
+
+            THEN("paths of dogs are returned by slots") {
+                CHECK(paths.start_xs == std::vector<CoordD>{0.0, 10.0, 3.0});
+                CHECK(paths.start_ys == std::vector<CoordD>{0.0, 4.0, 0.0});
+                CHECK(paths.end_xs == std::vector<CoordD>{3.0, 10.0, 3.0});
+                CHECK(paths.end_ys == std::vector<CoordD>{0.0, 2.5, 0.0});
+            }
+        }
+
+        WHEN("dogs move beyond the roads") {
+            game_session.MoveDogs(10.0);
+
+            THEN("dogs stop at the border of the roads") {
+                CHECK(east_dog.GetPosition().x == 10.0 + Road::HALF_WIDTH);
+                CHECK(east_dog.GetPosition().y == 0.0);
+                CHECK(east_dog.GetSpeed().x == 0.0);
+                CHECK(north_dog.GetPosition().x == 10.0);
+                CHECK(north_dog.GetPosition().y == -Road::HALF_WIDTH);
+                CHECK(north_dog.GetSpeed().y == 0.0);
+            }
+
+            AND_WHEN("the next tick comes") {
+                game_session.MoveDogs(1.0);
+
+                THEN("stopped dogs stay in place") {
+                    CHECK(east_dog.GetPosition().x == 10.0 + Road::HALF_WIDTH);
+                    CHECK(north_dog.GetPosition().y == -Road::HALF_WIDTH);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Game session tick changes") {
+    Map map{Map::Id{"map1"s}, "Map 1"s, 1.0, Game::DEFAULT_BAG_CAPACITY};
+    map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, Coord{10}});
+    map.BuildRoadCorridors();
+
+    GIVEN("a game session with dogs after a finished tick") {
+        GameSession game_session{&map};
+        auto moving_dog = game_session.CreateDog("moving"s);
+        auto standing_dog = game_session.CreateDog("standing"s);
+        game_session.FinishTick();
+        REQUIRE(game_session.GetTick() == 1);
+        REQUIRE(game_session.GetRecentTickChanges().size() == 1);
+        // Новые собаки попадают в изменения тика, в котором они появились
+        CHECK(game_session.GetRecentTickChanges().back()->changed_dogs == std::vector<size_t>{0, 1});
+
+        WHEN("dog data is set to the same values") {
+            standing_dog.SetSpeed(Dog::Speed{0.0, 0.0});
+            standing_dog.SetDirection(Direction::NORTH);
+            standing_dog.SetPosition(standing_dog.GetPosition());
+            standing_dog.ClearBag();
+            game_session.MoveDogs(1.0);
+            game_session.FinishTick();
+
+            THEN("the dog is not changed") {
+                CHECK(game_session.GetRecentTickChanges().back()->changed_dogs.empty());
+            }
+        }
+
+        WHEN("a dog changes several times during a tick") {
+            moving_dog.SetDirection(Direction::EAST);
+            moving_dog.SetSpeed(Dog::Speed{1.0, 0.0});
+            REQUIRE(moving_dog.AddItemInBag(Dog::BagItem{1, 0}));
+            game_session.MoveDogs(1.0);
+            game_session.FinishTick();
+
+            THEN("it is recorded once in the changes of the tick") {
+                const auto& changes = *game_session.GetRecentTickChanges().back();
+                CHECK(changes.tick == 2);
+                CHECK(changes.changed_dogs == std::vector<size_t>{0});
+            }
+
+            AND_WHEN("the dog keeps moving in the next tick") {
+                game_session.MoveDogs(1.0);
+                game_session.FinishTick();
+
+                THEN("it is changed in that tick too") {
+                    CHECK(game_session.GetRecentTickChanges().back()->changed_dogs == std::vector<size_t>{0});
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Game sessions registry") {
+    Map map1{Map::Id{"map1"s}, "Map 1"s, 4.0, Game::DEFAULT_BAG_CAPACITY};
+    map1.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, Coord{40}});
+    Map map2{Map::Id{"map2"s}, "Map 2"s, 4.0, Game::DEFAULT_BAG_CAPACITY};
+    map2.AddRoad(Road{Road::VERTICAL, Point{0, 0}, Coord{40}});
+
+    GIVEN("a game with limited session players") {
+        Game game{Game::DEFAULT_SPEED, Game::DEFAULT_BAG_CAPACITY, 2};
+        game.AddMap(map1);
+        game.AddMap(map2);
+        const auto* game_map1 = game.FindMap(Map::Id{"map1"s});
+        const auto* game_map2 = game.FindMap(Map::Id{"map2"s});
+
+        THEN("no sessions before players join") {
+            CHECK(game.GetMapSessions(Map::Id{"map1"s}).empty());
+            CHECK(game.GetSessions().empty());
+        }
+
+        WHEN("players join maps") {
+            for (int i = 0; i < 5; ++i) {
+                game.GetSessionToJoin(game_map1)->CreateDog("dog"s);
+            }
+            game.GetSessionToJoin(game_map2)->CreateDog("dog"s);
+
+            THEN("new session of the map is opened when session is full") {
+                const auto& map1_sessions = game.GetMapSessions(Map::Id{"map1"s});
+                REQUIRE(map1_sessions.size() == 3);
+                CHECK(map1_sessions.at(0)->GetDogCount() == 2);
+                CHECK(map1_sessions.at(1)->GetDogCount() == 2);
+                CHECK(map1_sessions.at(2)->GetDogCount() == 1);
+                CHECK(map1_sessions.at(2)->GetMap() == game_map1);
+                CHECK(game.GetSessionToJoin(game_map1) == map1_sessions.at(2));
+
+                REQUIRE(game.GetMapSessions(Map::Id{"map2"s}).size() == 1);
+                CHECK(game.GetMapSessions(Map::Id{"map2"s}).at(0)->GetMap() == game_map2);
+                CHECK(game.GetSessions().size() == 4);
+            }
+        }
+    }
+
+    GIVEN("a game with unlimited session players") {
+        Game game;
+        game.AddMap(map1);
+        const auto* game_map1 = game.FindMap(Map::Id{"map1"s});
+        for (int i = 0; i < 100; ++i) {
+            game.GetSessionToJoin(game_map1)->CreateDog("dog"s);
+        }
+
+        THEN("all players are in one session") {
+            REQUIRE(game.GetMapSessions(Map::Id{"map1"s}).size() == 1);
+            CHECK(game.GetMapSessions(Map::Id{"map1"s}).at(0)->GetDogCount() == 100);
+        }
+    }
+}
+
+SCENARIO("Road spatial index") {
+    Map map{Map::Id{"map1"s}, "Map 1"s, 4.0, Game::DEFAULT_BAG_CAPACITY};
+    map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, Coord{40}});
+    map.AddRoad(Road{Road::VERTICAL, Point{40, 0}, Coord{30}});
+    map.AddRoad(Road{Road::HORIZONTAL, Point{40, 30}, Coord{0}});
+    map.AddRoad(Road{Road::VERTICAL, Point{0, 0}, Coord{30}});
+    map.AddRoad(Road{Road::HORIZONTAL, Point{-17, 15}, Coord{-3}});
+
+    GIVEN("points around the roads") {
+        THEN("roads near the point are the same as found by full scan") {
+            for (double x = -20.0; x <= 45.0; x += 0.1) {
+                for (double y = -5.0; y <= 35.0; y += 0.1) {
+                    PointD point{x, y};
+                    std::vector<size_t> expected;
+                    for (size_t i = 0; i < map.GetRoads().size(); ++i) {
+                        if (map.GetRoads()[i].Contains(point)) {
+                            expected.push_back(i);
+                        }
+                    }
+
+                    std::vector<size_t> found;
+                    for (size_t i : map.GetRoadsNear(point)) {
+                        if (map.GetRoads()[i].Contains(point)) {
+                            found.push_back(i);
+                        }
+                    }
+                    INFO("point: " << x << ", " << y);
+                    REQUIRE(found == expected);
+                }
+            }
+        }
+    }
+}
+
+namespace {
+
+// Граница движения, найденная последовательным обходом дорог (как до появления коридоров)
+CoordD FindMoveLimitByRoadsScan(const Map& map, PointD pos, Direction direction) {
+    std::unordered_set<size_t> viewed_road_indeces;
+    while (true) {
+        const auto& roads = map.GetRoads();
+        auto road_it = std::find_if(roads.begin(), roads.end(), [&](const Road& road) {
+            return !viewed_road_indeces.count(&road - roads.data()) && road.Contains(pos);
+        });
+        if (road_it == roads.end()) {
+            break;
+        }
+        viewed_road_indeces.insert(road_it - roads.begin());
+
+        const auto& road = *road_it;
+        switch (direction) {
+            case Direction::NORTH: pos.y = std::min(road.GetStart().y, road.GetEnd().y) - Road::HALF_WIDTH; break;
+            case Direction::SOUTH: pos.y = std::max(road.GetStart().y, road.GetEnd().y) + Road::HALF_WIDTH; break;
+            case Direction::WEST: pos.x = std::min(road.GetStart().x, road.GetEnd().x) - Road::HALF_WIDTH; break;
+            case Direction::EAST: pos.x = std::max(road.GetStart().x, road.GetEnd().x) + Road::HALF_WIDTH; break;
+        }
+    }
+    return (direction == Direction::NORTH || direction == Direction::SOUTH) ? pos.y : pos.x;
+}
+
+}  // namespace
+
+SCENARIO("Road corridors") {
+    std::mt19937 rand_engine(42);
+    std::uniform_int_distribution<Coord> coord(0, 30);
+
+    GIVEN("maps with random roads") {
+        THEN("move limit is the same as found by full roads scan") {
+            for (int map_index = 0; map_index < 50; ++map_index) {
+                Map map{Map::Id{"map"s}, "Map"s, 1.0, Game::DEFAULT_BAG_CAPACITY};
+                for (int i = 0; i < 20; ++i) {
+                    if (i % 2) {
+                        map.AddRoad(Road{Road::HORIZONTAL, Point{coord(rand_engine), coord(rand_engine)}, coord(rand_engine)});
+                    } else {
+                        map.AddRoad(Road{Road::VERTICAL, Point{coord(rand_engine), coord(rand_engine)}, coord(rand_engine)});
+                    }
+                }
+                map.BuildRoadCorridors();
+
+                std::uniform_int_distribution<size_t> road_index(0, map.GetRoads().size() - 1);
+                std::uniform_real_distribution<double> offset(-Road::HALF_WIDTH, Road::HALF_WIDTH);
+                for (int i = 0; i < 200; ++i) {
+                    const auto& road = map.GetRoads().at(road_index(rand_engine));
+                    std::uniform_real_distribution<double> along_x(std::min(road.GetStart().x, road.GetEnd().x), 
+                                                                   std::max(road.GetStart().x, road.GetEnd().x));
+                    std::uniform_real_distribution<double> along_y(std::min(road.GetStart().y, road.GetEnd().y), 
+                                                                   std::max(road.GetStart().y, road.GetEnd().y));
+                    PointD pos{along_x(rand_engine) + offset(rand_engine), along_y(rand_engine) + offset(rand_engine)};
+                    for (auto direction : {Direction::NORTH, Direction::SOUTH, Direction::WEST, Direction::EAST}) {
+                        INFO("map: " << map_index << ", pos: " << pos.x << ", " << pos.y);
+                        REQUIRE(map.GetMoveLimit(pos, direction) == FindMoveLimitByRoadsScan(map, pos, direction));
+                    }
+                }
+            }
+        }
     }
 }
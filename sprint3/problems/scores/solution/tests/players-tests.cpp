@@ -0,0 +1,223 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "../src/model.h"
+#include "../src/players.h"
+
+using namespace std::literals;
+using namespace model;
+using players::Players;
+using players::SessionSnapshot;
+
+namespace {
+
+std::unordered_set<GameSession::LostObject::Id> LostObjectIds(const SessionSnapshot& snapshot) {
+    std::unordered_set<GameSession::LostObject::Id> ids;
+    for (const auto& lost_object : snapshot.lost_objects) {
+        ids.insert(lost_object.id);
+    }
+    return ids;
+}
+
+std::vector<size_t> SortedChangedDogs(const GameSession::TickChanges& changes) {
+    auto changed_dogs = changes.changed_dogs;
+    std::sort(changed_dogs.begin(), changed_dogs.end());
+    return changed_dogs;
+}
+
+// Завершает тик сессии так же, как Application::Tick
+void FinishTick(Players& players, GameSession* session) {
+    session->FinishTick();
+    players.PublishSessionSnapshot(session);
+}
+
+}  // namespace
+
+SCENARIO("Session snapshot changes") {
+    Map map{Map::Id{"map1"s}, "Map 1"s, 4.0, Game::DEFAULT_BAG_CAPACITY};
+    map.AddRoad(Road{Road::HORIZONTAL, Point{0, 0}, Coord{40}});
+    map.AddRoad(Road{Road::VERTICAL, Point{40, 0}, Coord{30}});
+    map.BuildRoadCorridors();
+
+    Game game;
+    game.AddMap(map);
+    auto session = game.CreateSession(game.FindMap(Map::Id{"map1"s}));
+
+    GIVEN("a session with two players") {
+        Players players;
+        auto first = players.Add(session->CreateDog("first"s), session).player;
+        auto second = players.Add(session->CreateDog("second"s), session).player;
+
+        auto snapshot = first->GetSessionSnapshot();
+        REQUIRE(snapshot->tick == 0);
+        REQUIRE(snapshot->players.size() == 2);
+        CHECK(snapshot->recent_changes.empty());
+        CHECK(snapshot->HasChangesSince(0));
+
+        WHEN("the first tick finishes") {
+            FinishTick(players, session);
+            snapshot = first->GetSessionSnapshot();
+
+            THEN("players that joined before the tick are in its changes") {
+                REQUIRE(snapshot->tick == 1);
+                REQUIRE(snapshot->recent_changes.size() == 1);
+                CHECK(snapshot->recent_changes.back()->tick == 1);
+                CHECK(SortedChangedDogs(*snapshot->recent_changes.back()) == std::vector<size_t>{0, 1});
+                CHECK(snapshot->MergeChangesSince(0).changed_players == std::vector<bool>{true, true});
+            }
+        }
+
+        WHEN("only the second player changes between ticks") {
+            FinishTick(players, session);
+            second->ChangeDirection(Direction::EAST);
+
+            THEN("the change is published with the next tick") {
+                CHECK(first->GetSessionSnapshot()->players[1].speed.x == 0.0);
+
+                FinishTick(players, session);
+                snapshot = first->GetSessionSnapshot();
+                REQUIRE(snapshot->tick == 2);
+                CHECK(snapshot->recent_changes.back()->tick == 2);
+                CHECK(snapshot->recent_changes.back()->changed_dogs == std::vector<size_t>{1});
+                CHECK(snapshot->players[1].speed.x == 4.0);
+
+                REQUIRE(snapshot->HasChangesSince(1));
+                CHECK(snapshot->MergeChangesSince(1).changed_players == std::vector<bool>{false, true});
+                CHECK(snapshot->MergeChangesSince(0).changed_players == std::vector<bool>{true, true});
+                CHECK(snapshot->MergeChangesSince(2).changed_players == std::vector<bool>{false, false});
+            }
+        }
+
+        WHEN("players make more actions between two ticks than the changes ring holds") {
+            FinishTick(players, session);
+            for (size_t i = 0; i < 2 * GameSession::MAX_RECENT_TICKS; ++i) {
+                first->ChangeDirection(i % 2 ? Direction::WEST : Direction::EAST);
+            }
+            FinishTick(players, session);
+            snapshot = first->GetSessionSnapshot();
+
+            THEN("all actions are merged into the changes of one tick") {
+                REQUIRE(snapshot->tick == 2);
+                REQUIRE(snapshot->recent_changes.size() == 2);
+                CHECK(snapshot->recent_changes.back()->changed_dogs == std::vector<size_t>{0});
+                REQUIRE(snapshot->HasChangesSince(1));
+                CHECK(snapshot->MergeChangesSince(1).changed_players == std::vector<bool>{true, false});
+            }
+        }
+
+        WHEN("nothing changes during a tick") {
+            FinishTick(players, session);
+            FinishTick(players, session);
+            snapshot = first->GetSessionSnapshot();
+
+            THEN("the tick has an empty delta") {
+                REQUIRE(snapshot->tick == 2);
+                const auto& changes = *snapshot->recent_changes.back();
+                CHECK(changes.changed_dogs.empty());
+                CHECK(changes.added_lost_objects.empty());
+                CHECK(changes.removed_lost_objects.empty());
+            }
+        }
+
+        WHEN("lost objects are added in one tick and one is taken in the next") {
+            session->GenerateLostObjects(3, 2);
+            FinishTick(players, session);
+            const auto added_snapshot = first->GetSessionSnapshot();
+            const auto added_ids = LostObjectIds(*added_snapshot);
+            REQUIRE(added_ids.size() == 3);
+
+            const auto taken_id = added_snapshot->lost_objects.front().id;
+            REQUIRE(session->RemoveLostObject(taken_id));
+            FinishTick(players, session);
+            snapshot = first->GetSessionSnapshot();
+
+            THEN("each tick records its own added and removed lost objects") {
+                const auto& added_changes = *snapshot->recent_changes[snapshot->recent_changes.size() - 2];
+                CHECK(std::unordered_set(added_changes.added_lost_objects.begin(), added_changes.added_lost_objects.end()) == added_ids);
+                CHECK(added_changes.removed_lost_objects.empty());
+
+                const auto& removed_changes = *snapshot->recent_changes.back();
+                CHECK(removed_changes.added_lost_objects.empty());
+                CHECK(removed_changes.removed_lost_objects == std::vector<GameSession::LostObject::Id>{taken_id});
+            }
+
+            THEN("a client that saw the lost object gets it in removed lost objects") {
+                const auto merged = snapshot->MergeChangesSince(added_snapshot->tick);
+                CHECK(merged.added_lost_objects.empty());
+                CHECK(merged.removed_lost_objects == std::unordered_set<GameSession::LostObject::Id>{taken_id});
+            }
+
+            THEN("a client that never saw the lost object gets neither addition nor removal of it") {
+                const auto merged = snapshot->MergeChangesSince(0);
+                auto remaining_ids = added_ids;
+                remaining_ids.erase(taken_id);
+                CHECK(merged.added_lost_objects == remaining_ids);
+                CHECK(merged.removed_lost_objects.empty());
+            }
+        }
+
+        WHEN("a lost object is added and taken during the same tick") {
+            FinishTick(players, session);
+            session->GenerateLostObjects(1, 2);
+            REQUIRE(session->RemoveLostObject(session->GetLostObjects().front().id));
+            FinishTick(players, session);
+
+            THEN("the tick records neither its addition nor its removal") {
+                const auto& changes = *first->GetSessionSnapshot()->recent_changes.back();
+                CHECK(changes.added_lost_objects.empty());
+                CHECK(changes.removed_lost_objects.empty());
+            }
+        }
+
+        WHEN("a player joins between ticks") {
+            FinishTick(players, session);
+            auto third = players.Add(session->CreateDog("third"s), session).player;
+            snapshot = third->GetSessionSnapshot();
+
+            THEN("the player is visible at once and is in the changes of the next tick") {
+                REQUIRE(snapshot->players.size() == 3);
+                CHECK(snapshot->tick == 1);
+                CHECK(snapshot->recent_changes.size() == 1);
+
+                FinishTick(players, session);
+                snapshot = third->GetSessionSnapshot();
+                CHECK(snapshot->recent_changes.back()->changed_dogs == std::vector<size_t>{2});
+                CHECK(snapshot->MergeChangesSince(1).changed_players == std::vector<bool>{false, false, true});
+            }
+        }
+
+        WHEN("more ticks finish than the changes ring holds") {
+            first->ChangeDirection(Direction::EAST);
+            FinishTick(players, session);
+            first->SetSpeed(Dog::Speed{0.0, 0.0});
+            for (size_t i = 0; i < GameSession::MAX_RECENT_TICKS; ++i) {
+                FinishTick(players, session);
+            }
+            snapshot = first->GetSessionSnapshot();
+            const auto tick = snapshot->tick;
+            REQUIRE(tick == 1 + GameSession::MAX_RECENT_TICKS);
+
+            THEN("only the last ticks are kept in order") {
+                REQUIRE(snapshot->recent_changes.size() == GameSession::MAX_RECENT_TICKS);
+                CHECK(snapshot->recent_changes.front()->tick == tick - GameSession::MAX_RECENT_TICKS + 1);
+                for (size_t i = 1; i < snapshot->recent_changes.size(); ++i) {
+                    CHECK(snapshot->recent_changes[i]->tick == snapshot->recent_changes[i - 1]->tick + 1);
+                }
+            }
+
+            THEN("older ticks require the full state") {
+                CHECK(snapshot->HasChangesSince(tick));
+                CHECK(snapshot->HasChangesSince(tick - GameSession::MAX_RECENT_TICKS));
+                CHECK_FALSE(snapshot->HasChangesSince(tick - GameSession::MAX_RECENT_TICKS - 1));
+                CHECK_FALSE(snapshot->HasChangesSince(tick + 1));
+            }
+
+            THEN("the oldest kept delta still covers the stopped player") {
+                const auto merged = snapshot->MergeChangesSince(tick - GameSession::MAX_RECENT_TICKS);
+                CHECK(merged.changed_players == std::vector<bool>{true, false});
+            }
+        }
+    }
+}
@@ -0,0 +1,285 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "../src/static_file_cache.h"
+
+using namespace std::literals;
+using static_files::StaticFileCache;
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Временный каталог статических файлов, удаляется вместе с содержимым
+class TempDir {
+public:
+    TempDir() {
+        std::random_device random_device;
+        path_ = fs::temp_directory_path() / ("static-file-cache-tests-"s + std::to_string(random_device()));
+        fs::create_directories(path_);
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    ~TempDir() {
+        std::error_code ec;
+        fs::remove_all(path_, ec);
+    }
+
+    const fs::path& GetPath() const noexcept {
+        return path_;
+    }
+
+    void WriteFile(const std::string& key, const std::string& data) const {
+        const auto file_path = path_ / key;
+        fs::create_directories(file_path.parent_path());
+        std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+        file << data;
+    }
+
+private:
+    fs::path path_;
+};
+
+std::string_view ContentTypeByExtension(const fs::path& file_path) {
+    const auto extension = file_path.extension();
+    if (extension == ".html"sv) {
+        return "text/html"sv;
+    }
+    if (extension == ".txt"sv) {
+        return "text/plain"sv;
+    }
+    return "application/octet-stream"sv;
+}
+
+std::string RandomData(size_t size) {
+    std::mt19937 generator{42};
+    std::uniform_int_distribution<int> byte{0, 255};
+    std::string data(size, '\0');
+    for (auto& c : data) {
+        c = static_cast<char>(byte(generator));
+    }
+    return data;
+}
+
+}  // namespace
+
+SCENARIO("Static file keys") {
+    GIVEN("decoded request paths") {
+        THEN("paths inside the root are normalized") {
+            CHECK(StaticFileCache::MakeKey("/"sv) == ""s);
+            CHECK(StaticFileCache::MakeKey("/index.html"sv) == "index.html"s);
+            CHECK(StaticFileCache::MakeKey("/js/"sv) == "js"s);
+            CHECK(StaticFileCache::MakeKey("/js/./game.js"sv) == "js/game.js"s);
+            CHECK(StaticFileCache::MakeKey("/js/../images/a.png"sv) == "images/a.png"s);
+            CHECK(StaticFileCache::MakeKey("/js/.."sv) == ""s);
+        }
+
+        THEN("paths leaving the root are rejected") {
+            CHECK_FALSE(StaticFileCache::MakeKey("/.."sv));
+            CHECK_FALSE(StaticFileCache::MakeKey("/../etc/passwd"sv));
+            CHECK_FALSE(StaticFileCache::MakeKey("/js/../../etc/passwd"sv));
+            CHECK_FALSE(StaticFileCache::MakeKey("/js/../.."sv));
+        }
+    }
+}
+
+SCENARIO("Static file cache") {
+    TempDir root;
+
+    GIVEN("a cache that fits two of three files") {
+        const auto data = RandomData(1000);
+        root.WriteFile("a.bin", data);
+        root.WriteFile("b.bin", data);
+        root.WriteFile("c.bin", data);
+        root.WriteFile("big.bin", RandomData(3000));
+
+        StaticFileCache::Options options;
+        options.max_memory_size = 2500;
+        options.refresh_period = 1h;
+        StaticFileCache cache{root.GetPath(), ContentTypeByExtension, options};
+
+        const auto a = cache.Find("a.bin"s);
+        const auto b = cache.Find("b.bin"s);
+        const auto c = cache.Find("c.bin"s);
+        REQUIRE(a);
+        REQUIRE(b);
+        REQUIRE(c);
+        REQUIRE(a->body);
+        REQUIRE(b->body);
+        REQUIRE(c->body);
+        CHECK(*a->body == data);
+        CHECK(a->info->size == 1000);
+        CHECK(a->info->content_type == "application/octet-stream"s);
+
+        THEN("the least recently used body is evicted") {
+            // Тела b и c остались в памяти, тело a загружается заново
+            CHECK(cache.Find("c.bin"s)->body == c->body);
+            CHECK(cache.Find("b.bin"s)->body == b->body);
+            const auto reloaded_a = cache.Find("a.bin"s);
+            CHECK(reloaded_a->body != a->body);
+            CHECK(*reloaded_a->body == data);
+
+            // Загрузка a вытеснила c, давно использованный из оставшихся
+            CHECK(cache.Find("b.bin"s)->body == b->body);
+            CHECK(cache.Find("c.bin"s)->body != c->body);
+        }
+
+        THEN("files larger than the memory limit are served from disk") {
+            const auto big = cache.Find("big.bin"s);
+            REQUIRE(big);
+            CHECK_FALSE(big->body);
+            CHECK(big->info->size == 3000);
+            CHECK(big->info->path == root.GetPath() / "big.bin");
+            // Файл, который не помещается в память, не вытесняет загруженные
+            CHECK(cache.Find("c.bin"s)->body == c->body);
+            CHECK(cache.Find("b.bin"s)->body == b->body);
+        }
+
+        THEN("missing files are not found") {
+            CHECK_FALSE(cache.Find("d.bin"s));
+        }
+
+        WHEN("a file is added after it was not found") {
+            REQUIRE_FALSE(cache.Find("d.bin"s));
+            root.WriteFile("d.bin", data);
+
+            THEN("the miss is remembered until the refresh period passes") {
+                CHECK_FALSE(cache.Find("d.bin"s));
+            }
+        }
+    }
+
+    GIVEN("a cache that remembers one miss") {
+        StaticFileCache::Options options;
+        options.refresh_period = 1h;
+        options.max_remembered_misses = 1;
+        StaticFileCache cache{root.GetPath(), ContentTypeByExtension, options};
+
+        REQUIRE_FALSE(cache.Find("a.txt"s));
+        REQUIRE_FALSE(cache.Find("b.txt"s));
+        root.WriteFile("a.txt", "a"s);
+        root.WriteFile("b.txt", "b"s);
+
+        THEN("older misses are forgotten when the limit is reached") {
+            const auto a = cache.Find("a.txt"s);
+            REQUIRE(a);
+            CHECK(*a->body == "a"s);
+            CHECK_FALSE(cache.Find("b.txt"s));
+        }
+    }
+
+    GIVEN("a cache that rechecks files on every request") {
+        root.WriteFile("index.html", "<html>root</html>"s);
+        root.WriteFile("docs/index.html", "<html>docs</html>"s);
+        root.WriteFile("docs/readme.txt", "first version"s);
+
+        StaticFileCache::Options options;
+        options.refresh_period = 0ms;
+        StaticFileCache cache{root.GetPath(), ContentTypeByExtension, options};
+
+        THEN("directories are mapped to their index.html") {
+            const auto root_index = cache.Find(""s);
+            REQUIRE(root_index);
+            CHECK(root_index->info->key == "index.html"s);
+            CHECK(*root_index->body == "<html>root</html>"s);
+
+            const auto docs_index = cache.Find("docs"s);
+            REQUIRE(docs_index);
+            CHECK(docs_index->info->key == "docs/index.html"s);
+            CHECK(docs_index->info->content_type == "text/html"s);
+            CHECK(*docs_index->body == "<html>docs</html>"s);
+        }
+
+        WHEN("a file is modified") {
+            const auto before = cache.Find("docs/readme.txt"s);
+            REQUIRE(before);
+            root.WriteFile("docs/readme.txt", "second, longer version"s);
+
+            THEN("the new content and ETag are served") {
+                const auto after = cache.Find("docs/readme.txt"s);
+                REQUIRE(after);
+                CHECK(*after->body == "second, longer version"s);
+                CHECK(after->info->size == "second, longer version"s.size());
+                CHECK(after->info->etag != before->info->etag);
+                CHECK(*before->body == "first version"s);
+            }
+        }
+
+        WHEN("a file is deleted") {
+            REQUIRE(cache.Find("docs/readme.txt"s));
+            fs::remove(root.GetPath() / "docs/readme.txt");
+
+            THEN("it is no longer found") {
+                CHECK_FALSE(cache.Find("docs/readme.txt"s));
+            }
+        }
+
+        WHEN("a file is added after indexing") {
+            root.WriteFile("new.txt", "new file"s);
+
+            THEN("it is found") {
+                const auto file = cache.Find("new.txt"s);
+                REQUIRE(file);
+                CHECK(*file->body == "new file"s);
+            }
+        }
+    }
+
+    GIVEN("symbolic links inside the root") {
+        TempDir outside;
+        outside.WriteFile("secret.txt", "secret"s);
+        outside.WriteFile("index.html", "<html>secret</html>"s);
+        root.WriteFile("public.txt", "public"s);
+        fs::create_symlink(outside.GetPath() / "secret.txt", root.GetPath() / "secret.txt");
+        fs::create_directory_symlink(outside.GetPath(), root.GetPath() / "outside");
+        fs::create_symlink(root.GetPath() / "public.txt", root.GetPath() / "alias.txt");
+
+        StaticFileCache cache{root.GetPath(), ContentTypeByExtension};
+
+        THEN("files outside the root are not served through them") {
+            CHECK_FALSE(cache.Find("secret.txt"s));
+            CHECK_FALSE(cache.Find("outside/secret.txt"s));
+            CHECK_FALSE(cache.Find("outside"s));
+        }
+
+        THEN("links to files inside the root are served") {
+            const auto alias = cache.Find("alias.txt"s);
+            REQUIRE(alias);
+            CHECK(*alias->body == "public"s);
+        }
+    }
+
+    GIVEN("text and binary files") {
+        const auto repetitive = std::string(4096, 'a');
+        root.WriteFile("repetitive.txt", repetitive);
+        root.WriteFile("random.txt", RandomData(4096));
+        root.WriteFile("repetitive.bin", repetitive);
+
+        StaticFileCache cache{root.GetPath(), ContentTypeByExtension};
+
+        THEN("a gzip variant is kept only for compressible types that shrink well") {
+            const auto compressible = cache.Find("repetitive.txt"s);
+            REQUIRE(compressible);
+            REQUIRE(compressible->gzip_body);
+            CHECK(compressible->gzip_body->size() * 10 <= repetitive.size() * 9);
+            CHECK(compressible->info->gzip_etag != compressible->info->etag);
+
+            // Случайные данные сжимаются хуже порога в 90% исходного размера
+            const auto incompressible = cache.Find("random.txt"s);
+            REQUIRE(incompressible);
+            CHECK(incompressible->body);
+            CHECK_FALSE(incompressible->gzip_body);
+
+            const auto binary = cache.Find("repetitive.bin"s);
+            REQUIRE(binary);
+            CHECK(binary->body);
+            CHECK_FALSE(binary->gzip_body);
+        }
+    }
+}
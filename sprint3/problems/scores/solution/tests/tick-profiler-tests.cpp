@@ -0,0 +1,154 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/tick_profiler.h"
+
+using namespace std::literals;
+using namespace tick_profiler;
+
+namespace {
+
+struct SessionPhase {
+    std::string_view map_id;
+    std::size_t session_index;
+    Phase phase;
+    Clock::duration duration;
+};
+
+// Завершает тик с заданными длительностями. Длительность тика EndTick измеряет сам, поэтому она
+// получается не меньше duration
+void SubmitTick(TickProfiler& profiler, Clock::duration duration,
+                std::vector<std::pair<Phase, Clock::duration>> tick_phases,
+                std::vector<SessionPhase> session_phases = {}) {
+    auto profile = profiler.BeginTick();
+    REQUIRE(profile);
+    profile->start = Clock::now() - duration;
+    for (const auto& [phase, phase_duration] : tick_phases) {
+        profile->phases[static_cast<std::size_t>(phase)] = phase_duration;
+    }
+    for (const auto& session_phase : session_phases) {
+        auto session = std::find_if(profile->sessions.begin(), profile->sessions.end(), [&](const SessionProfile& session) {
+            return session.map_id == session_phase.map_id && session.session_index == session_phase.session_index;
+        });
+        if (session == profile->sessions.end()) {
+            session = profile->sessions.insert(profile->sessions.end(), SessionProfile{session_phase.map_id, session_phase.session_index});
+        }
+        session->phases[static_cast<std::size_t>(session_phase.phase)] = session_phase.duration;
+    }
+    profiler.EndTick(std::move(profile));
+}
+
+// Разбирает строки "стек значение" формата flamegraph.pl
+std::map<std::string, long long> ParseFoldedStacks(const std::string& folded) {
+    std::map<std::string, long long> stacks;
+    std::istringstream input(folded);
+    for (std::string line; std::getline(input, line);) {
+        const auto separator = line.rfind(' ');
+        REQUIRE(separator != std::string::npos);
+        const auto value = std::stoll(line.substr(separator + 1));
+        CHECK(value > 0);
+        CHECK(stacks.emplace(line.substr(0, separator), value).second);
+    }
+    return stacks;
+}
+
+}  // namespace
+
+SCENARIO("Tick profiler") {
+    GIVEN("a profiler with zero depth") {
+        TickProfiler profiler{0};
+
+        THEN("profiling is disabled") {
+            CHECK(profiler.BeginTick() == nullptr);
+            profiler.EndTick(nullptr);
+            CHECK(profiler.ToFoldedStacks().empty());
+        }
+    }
+
+    GIVEN("a profiler keeping three ticks") {
+        TickProfiler profiler{3};
+
+        WHEN("no tick has finished") {
+            THEN("there are no stacks") {
+                CHECK(profiler.ToFoldedStacks().empty());
+            }
+        }
+
+        WHEN("a tick with tick and session phases finishes") {
+            SubmitTick(profiler, 10ms, {{Phase::GroupSessions, 1ms}, {Phase::GenerateLoot, 2ms}},
+                       {{"map1"sv, 0, Phase::FindEvents, 3ms},
+                        {"map1"sv, 0, Phase::BuildItems, 0ms},
+                        {"map1"sv, 1, Phase::ApplyEvents, 500us}});
+
+            THEN("phases are written as folded stacks in microseconds") {
+                const auto folded = profiler.ToFoldedStacks();
+                CHECK(folded.find("tick;groupSessions 1000\n"s) != std::string::npos);
+                CHECK(folded.find("tick;session map1#0;findEvents 3000\n"s) != std::string::npos);
+
+                const auto stacks = ParseFoldedStacks(folded);
+                CHECK(stacks.size() == 5);
+                CHECK(stacks.at("tick;groupSessions"s) == 1000);
+                CHECK(stacks.at("tick;generateLoot"s) == 2000);
+                CHECK(stacks.at("tick;session map1#0;findEvents"s) == 3000);
+                CHECK(stacks.at("tick;session map1#1;applyEvents"s) == 500);
+                // Время тика вне этапов
+                CHECK(stacks.at("tick"s) >= 3500);
+                // Этапы нулевой длительности не выводятся
+                CHECK(stacks.count("tick;session map1#0;buildItems"s) == 0);
+            }
+        }
+
+        WHEN("sessions processed in parallel take longer than the tick") {
+            SubmitTick(profiler, 1ms, {}, {{"map1"sv, 0, Phase::FindEvents, 5ms}, {"map1"sv, 1, Phase::FindEvents, 5ms}});
+
+            THEN("there is no own time of the tick") {
+                const auto stacks = ParseFoldedStacks(profiler.ToFoldedStacks());
+                CHECK(stacks.size() == 2);
+                CHECK(stacks.count("tick"s) == 0);
+            }
+        }
+
+        WHEN("fewer ticks than the depth finish") {
+            SubmitTick(profiler, 0ms, {{Phase::GroupSessions, 1ms}});
+            SubmitTick(profiler, 0ms, {{Phase::GroupSessions, 2ms}});
+
+            THEN("all finished ticks are summed") {
+                CHECK(ParseFoldedStacks(profiler.ToFoldedStacks()).at("tick;groupSessions"s) == 3000);
+            }
+        }
+
+        WHEN("more ticks than the depth finish") {
+            for (int i = 1; i <= 5; ++i) {
+                SubmitTick(profiler, 0ms, {{Phase::GroupSessions, i * 1ms}});
+            }
+
+            THEN("only the last ticks are summed") {
+                CHECK(ParseFoldedStacks(profiler.ToFoldedStacks()).at("tick;groupSessions"s) == 3000 + 4000 + 5000);
+            }
+        }
+
+        WHEN("slots still hold profiles of older ticks") {
+            for (int i = 0; i < 3; ++i) {
+                SubmitTick(profiler, 0ms, {{Phase::GroupSessions, 1ms}});
+            }
+            // Профиль тика 5 перезаписывает слот тика 2, а слоты тиков 3 и 4 всё ещё хранят тики 0 и 1
+            auto profile = profiler.BeginTick();
+            REQUIRE(profile);
+            REQUIRE(profile->tick == 3);
+            profile->tick = 5;
+            profile->start = Clock::now();
+            profile->phases[static_cast<std::size_t>(Phase::GroupSessions)] = 7ms;
+            profiler.EndTick(std::move(profile));
+
+            THEN("profiles of other ticks are skipped") {
+                CHECK(ParseFoldedStacks(profiler.ToFoldedStacks()).at("tick;groupSessions"s) == 7000);
+            }
+        }
+    }
+}
@@ -0,0 +1,131 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../src/token_index.h"
+
+using namespace std::literals;
+using namespace players;
+
+SCENARIO("Token parsing") {
+    GIVEN("a valid token") {
+        auto token = Token::FromString("0123456789abcdefFEDCBA9876543210"sv);
+        THEN("both halves are parsed") {
+            REQUIRE(token);
+            CHECK(token->hi == 0x0123456789abcdefull);
+            CHECK(token->lo == 0xfedcba9876543210ull);
+        }
+    }
+    GIVEN("invalid tokens") {
+        THEN("no token is parsed") {
+            CHECK_FALSE(Token::FromString(""sv));
+            CHECK_FALSE(Token::FromString("0123456789abcdef0123456789abcde"sv));
+            CHECK_FALSE(Token::FromString("0123456789abcdef0123456789abcdef0"sv));
+            CHECK_FALSE(Token::FromString("0123456789abcdef0123456789abcdeg"sv));
+            CHECK_FALSE(Token::FromString("0123456789abcdef 123456789abcdef"sv));
+        }
+    }
+    GIVEN("a token") {
+        Token token{0x0123456789ABCDEFull, 0xFEDCBA9876543210ull};
+        THEN("it is formatted with lowercase digits and parsed back") {
+            CHECK(token.ToString() == "0123456789abcdeffedcba9876543210"s);
+            CHECK(Token::FromString(token.ToString()) == token);
+        }
+    }
+}
+
+SCENARIO("Token generation") {
+    GIVEN("tokens generated concurrently") {
+        static constexpr size_t THREAD_COUNT = 4;
+        static constexpr size_t TOKENS_PER_THREAD = 10'000;
+        std::vector<std::vector<Token>> tokens(THREAD_COUNT);
+        {
+            std::vector<std::jthread> generators;
+            for (auto& thread_tokens : tokens) {
+                generators.emplace_back([&thread_tokens] {
+                    for (size_t i = 0; i < TOKENS_PER_THREAD; ++i) {
+                        thread_tokens.push_back(GenerateToken());
+                    }
+                });
+            }
+        }
+
+        THEN("all tokens are unique and survive formatting") {
+            TokenIndex<int> index;
+            int value = 0;
+            for (const auto& thread_tokens : tokens) {
+                for (const auto& token : thread_tokens) {
+                    CHECK(index.Insert(token, &value));
+                    CHECK(Token::FromString(token.ToString()) == token);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Token index") {
+    std::mt19937_64 rand_engine(42);
+
+    GIVEN("an index with many tokens") {
+        TokenIndex<int> index;
+        std::vector<int> values(10'000);
+        std::vector<Token> keys;
+        for (auto& value : values) {
+            keys.push_back(Token{rand_engine(), rand_engine()});
+            REQUIRE(index.Insert(keys.back(), &value));
+        }
+
+        THEN("every token is found") {
+            for (size_t i = 0; i < keys.size(); ++i) {
+                CHECK(index.Find(keys[i]) == &values[i]);
+            }
+        }
+        THEN("unknown tokens are not found") {
+            for (int i = 0; i < 1000; ++i) {
+                CHECK(index.Find(Token{rand_engine(), rand_engine()}) == nullptr);
+            }
+        }
+        THEN("token can't be inserted twice") {
+            int other_value = 0;
+            CHECK_FALSE(index.Insert(keys.front(), &other_value));
+            CHECK(index.Find(keys.front()) == &values.front());
+        }
+    }
+
+    GIVEN("readers running while tokens are inserted") {
+        TokenIndex<int> index;
+        std::vector<int> values(20'000);
+        std::vector<Token> keys;
+        for (size_t i = 0; i < values.size(); ++i) {
+            keys.push_back(Token{rand_engine(), rand_engine()});
+        }
+
+        std::atomic<size_t> inserted_count{0};
+        std::atomic<bool> lookup_failed{false};
+        std::vector<std::jthread> readers;
+        for (int i = 0; i < 4; ++i) {
+            readers.emplace_back([&] {
+                while (inserted_count.load() < keys.size()) {
+                    const size_t known_count = inserted_count.load();
+                    for (size_t j = 0; j < known_count; j += 7) {
+                        if (index.Find(keys[j]) != &values[j]) {
+                            lookup_failed = true;
+                        }
+                    }
+                }
+            });
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            index.Insert(keys[i], &values[i]);
+            ++inserted_count;
+        }
+        readers.clear();
+
+        THEN("readers always find inserted tokens") {
+            CHECK_FALSE(lookup_failed);
+        }
+    }
+}